@@ -0,0 +1,463 @@
+#include "fr.hpp"
+#include <algorithm>
+#include <sys/stat.h>
+
+// Compiled device database.
+//
+// Parsing the text fr.cfg each time a device is selected or a database
+// is opened is slow when the devices define thousands of ports.  The
+// config file is compiled once into fr.cdb next to it: per device, the
+// ports and interrupts sorted by address and the IO blocks.  The file is
+// read with one read, without any parsing, and is compiled again when it
+// is older than fr.cfg or fails the checks of check_image().  It is
+// written to a temporary file renamed into place.  If it cannot be
+// written, the compiled image is only kept in memory.  The device chooser
+// (choose_ioport_device) still reads the text file itself.
+//
+// Image layout, all fields are uint32:
+//
+//      header          cdb_header_t
+//      devices         cdb_device_t[ndevices]
+//      ports           cdb_port_t[], per device: ports, then interrupts
+//      blocks          cdb_block_t[]
+//      strings         NUL terminated, offsets are from the image start
+
+#define CDB_MAGIC         0x42444346    // "FCDB"
+#define CDB_VERSION       1
+#define CDB_EXT           "cdb"
+
+struct cdb_header_t
+{
+  uint32 magic;
+  uint32 version;
+  uint32 cfg_size;      // the config file compiled
+  uint32 cfg_mtime;
+  uint32 ndevices;
+};
+
+struct cdb_device_t
+{
+  uint32 name;
+  uint32 ports;         // first port
+  uint32 nports;
+  uint32 ints;          // first interrupt
+  uint32 nints;
+  uint32 blocks;        // first block
+  uint32 nblocks;
+};
+
+struct cdb_port_t
+{
+  uint32 address;
+  uint32 name;
+  uint32 cmt;
+};
+
+struct cdb_block_t
+{
+  uint32 start;
+  uint32 end;
+  uint32 name;
+};
+
+// a device while compiling
+struct cfg_device_t
+{
+  uint32 name;
+  qvector<cdb_port_t> ports;
+  qvector<cdb_port_t> ints;
+  qvector<cdb_block_t> blocks;
+};
+
+static qvector<uchar> cdb_image;          // the compiled config file
+static qstring cdb_cfg;                   // its name
+static fr_device_t cdb_device;            // the last device found
+
+//--------------------------------------------------------------------------
+// compiler
+
+struct cfg_strings_t
+{
+  qvector<char> text;
+  uint32 add(const char *s)
+  {
+    uint32 off = uint32(text.size());
+    size_t len = strlen(s) + 1;
+    text.resize(off + len);
+    memcpy(&text[off], s, len);
+    return off;
+  }
+};
+
+static bool port_less(const cdb_port_t &a, const cdb_port_t &b)
+{
+  return a.address < b.address;
+}
+
+static bool block_less(const cdb_block_t &a, const cdb_block_t &b)
+{
+  return a.start < b.start;
+}
+
+static char *skip_spaces(char *p)
+{
+  while ( *p == ' ' || *p == '\t' )
+    p++;
+  return p;
+}
+
+// split off the next word of a line.
+static char *next_word(char **pp)
+{
+  char *p = skip_spaces(*pp);
+  char *word = p;
+  while ( *p != '\0' && *p != ' ' && *p != '\t' )
+    p++;
+  if ( *p != '\0' )
+    *p++ = '\0';
+  *pp = p;
+  return word;
+}
+
+static bool get_number(const char *word, uint32 *v)
+{
+  char *end;
+  *v = uint32(strtoul(word, &end, 0));
+  return end != word && *end == '\0';
+}
+
+// parse the config file. the string offsets are relative to 'strings'.
+static bool parse_cfg(
+        const char *path,
+        qvector<cfg_device_t> &devices,
+        cfg_strings_t &strings)
+{
+  FILE *fp = fopenRT(path);
+  if ( fp == NULL )
+    return false;
+
+  cfg_device_t *dev = NULL;
+  char line[MAXSTR];
+  while ( qfgets(line, sizeof(line), fp) != NULL )
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    // comments and lines starting with a space are ignored
+    if ( line[0] == ';' || line[0] == ' ' || line[0] == '\t' || line[0] == '\0' )
+      continue;
+
+    char *p = line;
+    char *word = next_word(&p);
+    if ( word[0] == '.' )
+    {
+      dev = NULL;
+      if ( strcmp(word, ".default") != 0 )
+      {
+        dev = &devices.push_back();
+        dev->name = strings.add(word + 1);
+      }
+      continue;
+    }
+    if ( dev == NULL )
+      continue;
+
+    uint32 a;
+    uint32 b;
+    if ( strcmp(word, "interrupt") == 0 )
+    {
+      char *name = next_word(&p);
+      if ( get_number(next_word(&p), &a) )
+      {
+        cdb_port_t &x = dev->ints.push_back();
+        x.address = a;
+        x.name = strings.add(name);
+        x.cmt = strings.add(skip_spaces(p));
+      }
+    }
+    else if ( strcmp(word, "area") == 0 )
+    {
+      char *cls = next_word(&p);
+      char *name = next_word(&p);
+      char *range = next_word(&p);
+      char *colon = strchr(range, ':');
+      if ( strcmp(cls, "IO") == 0 && colon != NULL )
+      {
+        *colon = '\0';
+        if ( get_number(range, &a) && get_number(colon + 1, &b) && a < b )
+        {
+          cdb_block_t &x = dev->blocks.push_back();
+          x.start = a;
+          x.end = b;
+          x.name = strings.add(name);
+        }
+      }
+    }
+    else if ( strchr(word, '.') == NULL && get_number(next_word(&p), &a) )
+    {
+      // a port. bits (PORT.BIT n) and the other directives are skipped.
+      cdb_port_t &x = dev->ports.push_back();
+      x.address = a;
+      x.name = strings.add(word);
+      x.cmt = strings.add(skip_spaces(p));
+    }
+  }
+  qfclose(fp);
+  return true;
+}
+
+// compile the config file into an image.
+static bool compile_cfg(const char *path, const struct stat &st, qvector<uchar> &image)
+{
+  qvector<cfg_device_t> devices;
+  cfg_strings_t strings;
+  cdb_header_t h;
+  if ( !parse_cfg(path, devices, strings) )
+    return false;
+
+  size_t nports = 0;
+  size_t nblocks = 0;
+  for ( size_t i = 0; i < devices.size(); i++ )
+  {
+    nports += devices[i].ports.size() + devices[i].ints.size();
+    nblocks += devices[i].blocks.size();
+  }
+  uint32 dev_off = sizeof(cdb_header_t);
+  uint32 port_off = uint32(dev_off + devices.size() * sizeof(cdb_device_t));
+  uint32 block_off = uint32(port_off + nports * sizeof(cdb_port_t));
+  uint32 str_off = uint32(block_off + nblocks * sizeof(cdb_block_t));
+  image.resize(str_off + strings.text.size());
+
+  h.magic = CDB_MAGIC;
+  h.version = CDB_VERSION;
+  h.cfg_size = uint32(st.st_size);
+  h.cfg_mtime = uint32(st.st_mtime);
+  h.ndevices = uint32(devices.size());
+  memcpy(&image[0], &h, sizeof(h));
+
+  cdb_device_t *pd = (cdb_device_t *)&image[dev_off];
+  cdb_port_t *pp = (cdb_port_t *)&image[port_off];
+  cdb_block_t *pb = (cdb_block_t *)&image[block_off];
+  uint32 np = 0;
+  uint32 nb = 0;
+  for ( size_t i = 0; i < devices.size(); i++ )
+  {
+    cfg_device_t &d = devices[i];
+    // stable: the first of several ports at an address is found first
+    std::stable_sort(d.ports.begin(), d.ports.end(), port_less);
+    std::stable_sort(d.ints.begin(), d.ints.end(), port_less);
+    std::sort(d.blocks.begin(), d.blocks.end(), block_less);
+
+    pd[i].name = d.name + str_off;
+    pd[i].ports = np;
+    pd[i].nports = uint32(d.ports.size());
+    pd[i].ints = np + pd[i].nports;
+    pd[i].nints = uint32(d.ints.size());
+    pd[i].blocks = nb;
+    pd[i].nblocks = uint32(d.blocks.size());
+    for ( int k = 0; k < 2; k++ )
+    {
+      const qvector<cdb_port_t> &v = k == 0 ? d.ports : d.ints;
+      for ( size_t j = 0; j < v.size(); j++, np++ )
+      {
+        pp[np] = v[j];
+        pp[np].name += str_off;
+        pp[np].cmt += str_off;
+      }
+    }
+    for ( size_t j = 0; j < d.blocks.size(); j++, nb++ )
+    {
+      pb[nb] = d.blocks[j];
+      pb[nb].name += str_off;
+    }
+  }
+  memcpy(&image[str_off], &strings.text[0], strings.text.size());
+  return true;
+}
+
+//--------------------------------------------------------------------------
+// loader
+
+// is the string at off inside the string area of the image?
+inline bool check_string(uint32 off, uint64 str_off, size_t size)
+{
+  return off >= str_off && off < size;
+}
+
+// check every count and offset of an image read from the disk, so that
+// a truncated or damaged file is compiled again instead of being used.
+static bool check_image(const qvector<uchar> &image)
+{
+  size_t size = image.size();
+  const cdb_header_t *h = (const cdb_header_t *)&image[0];
+  uint64 dev_off = sizeof(cdb_header_t);
+  uint64 port_off = dev_off + uint64(h->ndevices) * sizeof(cdb_device_t);
+  if ( port_off > size )
+    return false;
+
+  const cdb_device_t *pd = (const cdb_device_t *)&image[size_t(dev_off)];
+  uint64 nports = 0;
+  uint64 nblocks = 0;
+  for ( uint32 i = 0; i < h->ndevices; i++ )
+  {
+    nports += uint64(pd[i].nports) + pd[i].nints;
+    nblocks += pd[i].nblocks;
+  }
+  uint64 block_off = port_off + nports * sizeof(cdb_port_t);
+  uint64 str_off = block_off + nblocks * sizeof(cdb_block_t);
+  // the strings are NUL terminated, so is the last one
+  if ( str_off > size || (str_off < size && image[size - 1] != '\0') )
+    return false;
+
+  const cdb_port_t *pp = (const cdb_port_t *)&image[size_t(port_off)];
+  const cdb_block_t *pb = (const cdb_block_t *)&image[size_t(block_off)];
+  for ( uint32 i = 0; i < h->ndevices; i++ )
+  {
+    const cdb_device_t &d = pd[i];
+    if ( !check_string(d.name, str_off, size)
+      || uint64(d.ports) + d.nports > nports
+      || uint64(d.ints) + d.nints > nports
+      || uint64(d.blocks) + d.nblocks > nblocks )
+    {
+      return false;
+    }
+  }
+  for ( uint64 i = 0; i < nports; i++ )
+    if ( !check_string(pp[i].name, str_off, size) || !check_string(pp[i].cmt, str_off, size) )
+      return false;
+  for ( uint64 i = 0; i < nblocks; i++ )
+    if ( !check_string(pb[i].name, str_off, size) )
+      return false;
+  return true;
+}
+
+static bool read_image(const char *path, const struct stat &st, qvector<uchar> &image)
+{
+  FILE *fp = fopenRB(path);
+  if ( fp == NULL )
+    return false;
+  uint32 size = qfsize(fp);
+  bool ok = size >= sizeof(cdb_header_t);
+  if ( ok )
+  {
+    image.resize(size);
+    ok = qfread(fp, &image[0], size) == int(size);
+  }
+  qfclose(fp);
+  if ( !ok )
+    return false;
+  const cdb_header_t *h = (const cdb_header_t *)&image[0];
+  return h->magic == CDB_MAGIC
+      && h->version == CDB_VERSION
+      && h->cfg_size == uint32(st.st_size)
+      && h->cfg_mtime == uint32(st.st_mtime)
+      && check_image(image);
+}
+
+// write the image to a temporary file renamed over the old one, so that
+// another IDA reading the file never sees a partial image.
+static void write_image(const char *path, const qvector<uchar> &image)
+{
+  char tmp[QMAXPATH];
+  qsnprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *fp = fopenWB(tmp);
+  if ( fp == NULL )
+    return;
+  bool ok = qfwrite(fp, &image[0], image.size()) == int(image.size());
+  qfclose(fp);
+  // rename does not replace an existing file on Windows
+  if ( ok && qrename(tmp, path) != 0 )
+    ok = qunlink(path) == 0 && qrename(tmp, path) == 0;
+  if ( !ok )
+    qunlink(tmp);
+}
+
+// load the compiled config file, compiling it if it is missing or older
+// than the config file.
+static bool load_cdb(const char *cfgfile)
+{
+  if ( !cdb_image.empty() && cdb_cfg == cfgfile )
+    return true;
+  fr_devdb_flush();
+
+  char cfgpath[QMAXPATH];
+  if ( getsysfile(cfgpath, sizeof(cfgpath), cfgfile, CFG_SUBDIR) == NULL )
+    return false;
+  struct stat cst;
+  if ( stat(cfgpath, &cst) != 0 )
+    return false;
+
+  char cdbpath[QMAXPATH];
+  set_file_ext(cdbpath, sizeof(cdbpath), cfgpath, CDB_EXT);
+  struct stat dst;
+  bool fresh = stat(cdbpath, &dst) == 0 && dst.st_mtime >= cst.st_mtime;
+  if ( !fresh || !read_image(cdbpath, cst, cdb_image) )
+  {
+    cdb_image.clear();
+    if ( !compile_cfg(cfgpath, cst, cdb_image) )
+    {
+      cdb_image.clear();
+      return false;
+    }
+    write_image(cdbpath, cdb_image);
+  }
+  cdb_cfg = cfgfile;
+  return true;
+}
+
+static void make_ports(qvector<ioport_t> &out, const cdb_port_t *p, uint32 n)
+{
+  const char *base = (const char *)&cdb_image[0];
+  out.resize(n);
+  for ( uint32 i = 0; i < n; i++ )
+  {
+    ioport_t &x = out[i];
+    memset(&x, 0, sizeof(x));
+    x.address = p[i].address;
+    x.name = (char *)base + p[i].name;
+    x.cmt = (char *)base + p[i].cmt;
+  }
+}
+
+// the ports, interrupts and IO blocks of a device of a config file, or
+// NULL. the result is valid until the next call.
+const fr_device_t *fr_find_device(const char *cfgfile, const char *dev)
+{
+  if ( !load_cdb(cfgfile) )
+    return NULL;
+
+  const uchar *base = &cdb_image[0];
+  const cdb_header_t *h = (const cdb_header_t *)base;
+  const cdb_device_t *pd = (const cdb_device_t *)(base + sizeof(cdb_header_t));
+  const cdb_port_t *pp = (const cdb_port_t *)(pd + h->ndevices);
+  uint32 nports = 0;
+  for ( uint32 i = 0; i < h->ndevices; i++ )
+    nports += pd[i].nports + pd[i].nints;
+  const cdb_block_t *pb = (const cdb_block_t *)(pp + nports);
+
+  for ( uint32 i = 0; i < h->ndevices; i++ )
+  {
+    const cdb_device_t &d = pd[i];
+    if ( strcmp((const char *)base + d.name, dev) != 0 )
+      continue;
+    make_ports(cdb_device.ports, pp + d.ports, d.nports);
+    make_ports(cdb_device.ints, pp + d.ints, d.nints);
+    cdb_device.blocks.resize(d.nblocks);
+    for ( uint32 k = 0; k < d.nblocks; k++ )
+    {
+      fr_devblock_t &b = cdb_device.blocks[k];
+      b.start = pb[d.blocks + k].start;
+      b.end = pb[d.blocks + k].end;
+      b.name = (const char *)base + pb[d.blocks + k].name;
+    }
+    return &cdb_device;
+  }
+  return NULL;
+}
+
+void fr_devdb_flush(void)
+{
+  cdb_image.clear();
+  cdb_cfg.clear();
+  cdb_device.ports.clear();
+  cdb_device.ints.clear();
+  cdb_device.blocks.clear();
+}
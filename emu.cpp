@@ -2,12 +2,12 @@
 #include "fr.hpp"
 #include "emu_search.h"
 
-// Analyze an instruction
-static ea_t next_insn(ea_t ea)
+// decode the instruction at ea into *x. returns the address after it or 0.
+static ea_t next_insn(ea_t ea, insn_t *x)
 {
-  if ( decode_insn(ea) == 0 )
+  if ( fr_decode_insn(ea, x) == 0 )
     return 0;
-  ea += cmd.size;
+  ea += x->size;
   return ea;
 }
 
@@ -36,6 +36,10 @@ static void handle_operand(const op_t &op)
       break;
 
     case o_imm:
+      // int #n / inte: the vector and its handler
+      if ( (cmd.itype == fr_int || cmd.itype == fr_inte) && op.n == 0 )
+        fr_add_vector_xrefs(op);
+
       // if current insn is ldi:32 #imm, r1
       // and next insn is call @r1,
       // replace the immediate value with an offset.
@@ -44,19 +48,18 @@ static void handle_operand(const op_t &op)
           cmd.Op2.type == o_reg)
       {
         const int callreg = cmd.Op2.reg;
-        insn_t cmd_backup = cmd;
-        if ( next_insn(cmd.ea + cmd.size ) > 0
-          && ( cmd.itype == fr_call || cmd.itype == fr_jmp )
-          && cmd.Op1.type == o_phrase
-          && cmd.Op1.specflag2 == fIGR
-          && cmd.Op1.reg == callreg )
+        insn_t next;
+        if ( next_insn(cmd.ea + cmd.size, &next) > 0
+          && ( next.itype == fr_call || next.itype == fr_jmp )
+          && next.Op1.type == o_phrase
+          && next.Op1.specflag2 == fIGR
+          && next.Op1.reg == callreg )
         {
           offset = true;
         }
-        cmd = cmd_backup;
         if( offset )
         {
-          //set_offset(cmd_backup.ea, 0, 0);
+          //set_offset(cmd.ea, 0, 0);
         }
       }
       doImmd(cmd.ea);
@@ -74,28 +77,28 @@ static void handle_operand(const op_t &op)
           && cmd.Op2.type == o_reg
           && cmd.Op2.reg == rR1 )
         {
-            insn_t current_insn = cmd;
-            next_insn(cmd.ea + cmd.size);
-            if ( cmd.itype == fr_extsb
-              && cmd.Op1.type == o_reg
-              && cmd.Op1.reg == rR1 )
+            insn_t next;
+            ea_t ea = next_insn(cmd.ea + cmd.size, &next);
+            if ( ea != 0
+              && next.itype == fr_extsb
+              && next.Op1.type == o_reg
+              && next.Op1.reg == rR1 )
             {
               ok = true;
             }
             if ( ok )
             {
               ok = false;
-              next_insn(cmd.ea + cmd.size);
-              if ( cmd.itype == fr_addn
-                && cmd.Op1.type == o_reg
-                && cmd.Op1.reg == rR14
-                && cmd.Op2.type == o_reg
-                && cmd.Op2.reg == rR1 )
+              if ( next_insn(ea, &next) != 0
+                && next.itype == fr_addn
+                && next.Op1.type == o_reg
+                && next.Op1.reg == rR14
+                && next.Op2.type == o_reg
+                && next.Op2.reg == rR1 )
               {
                 ok = true;
               }
             }
-            cmd = current_insn;
         }
         // ldi32 #our_value, Ri
         // addn R14, Ri
@@ -106,17 +109,16 @@ static void handle_operand(const op_t &op)
                && (cmd.Op2.reg == rR1 || cmd.Op2.reg == rR2) )
         {
           ushort the_reg = cmd.Op2.reg;
-          insn_t current_insn = cmd;
-          next_insn(cmd.ea + cmd.size);
-          if ( cmd.itype == fr_addn
-            && cmd.Op1.type == o_reg
-            && cmd.Op1.reg == rR14
-            && cmd.Op2.type == o_reg
-            && cmd.Op2.reg == the_reg )
+          insn_t next;
+          if ( next_insn(cmd.ea + cmd.size, &next) != 0
+            && next.itype == fr_addn
+            && next.Op1.type == o_reg
+            && next.Op1.reg == rR14
+            && next.Op2.type == o_reg
+            && next.Op2.reg == the_reg )
           {
             ok = true;
           }
-          cmd = current_insn;
         }
 
         if ( ok && may_create_stkvars() && !isDefArg(uFlag, op.n) )
@@ -159,18 +161,26 @@ static void handle_operand(const op_t &op)
       {
         cref_t reftype = cmd.itype == fr_call ? fl_CN : fl_JN;
         const int callreg = cmd.Op1.reg;
-        insn_t cmd_backup = cmd;
         ea_t to = 0;
-        if( decode_prev_insn(cmd.ea ) != BADADDR
-            && cmd.itype == fr_ldi_32
-            && cmd.Op1.type == o_imm
-            && cmd.Op2.type == o_reg
-            && cmd.Op2.reg == callreg )
+        // the register value is known from the function's constant propagation,
+        // or, outside of functions, from an ldi:32 just before
+        if ( fr_resolve_indirect(cmd.ea, &to) )
         {
           offset = true;
-          to = toEA(cmd.cs, cmd.Op1.value);
         }
-        cmd = cmd_backup;  
+        else
+        {
+          insn_t prev;
+          if( fr_decode_prev_insn(cmd.ea, &prev) != BADADDR
+              && prev.itype == fr_ldi_32
+              && prev.Op1.type == o_imm
+              && prev.Op2.type == o_reg
+              && prev.Op2.reg == callreg )
+          {
+            offset = true;
+            to = toEA(prev.cs, prev.Op1.value);
+          }
+        }
         if( offset ) 
         {
           // if ( !isDefArg(uFlag, 0) ) 
@@ -190,9 +200,9 @@ static void handle_operand(const op_t &op)
   }
 }
 
-inline bool is_stop (void)
+inline bool is_stop (const insn_t &x)
 {
-  uint32 feature = cmd.get_canon_feature();
+  uint32 feature = x.get_canon_feature();
   return (feature & CF_STOP) != 0;
 }
 
@@ -295,6 +305,19 @@ static void trace_sp(void)
   }
 }
 
+// ua_stkvar2() works on cmd: point it at the instruction at ea for the
+// duration of the call.
+static void create_stkvar_at(ea_t ea)
+{
+  insn_t saved = cmd;
+  if ( fr_decode_insn(ea, &cmd) != 0 )
+  {
+    ua_stkvar2(cmd.Op1, cmd.Op1.value, 0);
+    op_stkvar(cmd.ea, cmd.Op1.n);
+  }
+  cmd = saved;
+}
+
 void search_stack_vars()
 {
   // mov r14, rX
@@ -335,28 +358,16 @@ void search_stack_vars()
       SearchBackwardsForExtend extend;
       SearchBackwardsForLdi8 ldi8;
       SearchBackwardsForLdi32 ldi32;
-      ea_t save_ea = cmd.ea;
 
       if( extend.Search(cmd.ea, cmd.Op2.reg) )
       {
         if( ldi8.Search(extend.match_ea, cmd.Op2.reg))
-        {
-          decode_insn(ldi8.match_ea);
-          ua_stkvar2(cmd.Op1, cmd.Op1.value, 0);
-          op_stkvar(cmd.ea, cmd.Op1.n);
-
-          decode_insn(save_ea);
-        }
+          create_stkvar_at(ldi8.match_ea);
       }
       else if( ldi32.Search(cmd.ea, cmd.Op2.reg))
       {
           //msg("0x%a SearchBackwardsForLdi32\n", ldi32.match_ea);
-
-          decode_insn(ldi32.match_ea);
-          ua_stkvar2(cmd.Op1, cmd.Op1.value, 0);
-          op_stkvar(cmd.ea, cmd.Op1.n);
-
-          decode_insn(save_ea);
+          create_stkvar_at(ldi32.match_ea);
       }
     }
   }
@@ -367,27 +378,38 @@ void search_stack_vars()
 // Emulate an instruction.
 int idaapi emu(void)
 {
+  FR_STAT_SCOPE(FR_ST_EMU);
+  FR_SPAN("emu", cmd.ea);
+  fr_trace_poll();
 
-  bool flow = (!is_stop()) || (cmd.auxpref & INSN_DELAY_SHOT);
+  bool flow = (!is_stop(cmd)) || (cmd.auxpref & INSN_DELAY_SHOT);
   //msg("0x%a flow0 %d\n", cmd.ea, flow);
   if ( flow )
   {
-    insn_t cmd_backup = cmd;
-    if ( decode_prev_insn(cmd.ea) != BADADDR )
+    // the delay slot of a jmp:D / ret:D does not flow, unless something
+    // else jumps to it. the function's block graph knows the previous
+    // instruction once it is built.
+    int prev_flags = fr_cfg_prev_flags(cmd.ea);
+    if ( prev_flags >= 0 )
     {
-      flow = !(is_stop() && (cmd.auxpref & INSN_DELAY_SHOT));
-      //msg("0x%a flow1 %d\n", cmd.ea, flow);
+      flow = (prev_flags & (FR_CFG_STOP | FR_CFG_DELAY)) != (FR_CFG_STOP | FR_CFG_DELAY);
+    }
+    else
+    {
+      insn_t prev;
+      if ( fr_decode_prev_insn(cmd.ea, &prev) != BADADDR )
+        flow = !(is_stop(prev) && (prev.auxpref & INSN_DELAY_SHOT));
+    }
+    //msg("0x%a flow1 %d\n", cmd.ea, flow);
 
-      if(!flow)
-      {
-        xrefblk_t xb;
-        if( xb.first_to(cmd_backup.ea, XREF_ALL) )
-          flow = xb.next_to();
+    if(!flow)
+    {
+      xrefblk_t xb;
+      if( xb.first_to(cmd.ea, XREF_ALL) )
+        flow = xb.next_to();
 
-        //msg("0x%a flow2 %d\n", cmd.ea, flow);
-      }
+      //msg("0x%a flow2 %d\n", cmd.ea, flow);
     }
-    cmd = cmd_backup;
   }
 
   if ( cmd.Op1.type != o_void ) handle_operand(cmd.Op1);
@@ -395,6 +417,9 @@ int idaapi emu(void)
   if ( cmd.Op3.type != o_void ) handle_operand(cmd.Op3);
   if ( cmd.Op4.type != o_void ) handle_operand(cmd.Op4);
 
+  // mov Rx, tbr moves the vector table
+  fr_emu_tbr_write();
+
   if ( flow )
     ua_add_cref(0, cmd.ea + cmd.size, fl_F);
 
@@ -413,78 +438,81 @@ int idaapi emu(void)
 // Create a function frame
 bool idaapi create_func_frame(func_t *pfn)
 {
+  FR_STAT_SCOPE(FR_ST_FUNC_FRAME);
+  FR_SPAN("create_func_frame", pfn->startEA);
   ushort savedreg_size = 0;
   uint32 args_size = 0;
   uint32 localvar_size;
 
   ea_t ea = pfn->startEA;
+  insn_t insn;
   bool loopAgain = true;
 
-  while( decode_insn(ea) != 0 && loopAgain )
+  while( fr_decode_insn(ea, &insn) != 0 && loopAgain )
   {
     loopAgain = false;
-    if( cmd.itype == fr_stm0 || cmd.itype == fr_stm1)
+    if( insn.itype == fr_stm0 || insn.itype == fr_stm1)
     {
       for(int i =0; i < 8; i++ )
       {
-        if( cmd.Op1.value & (1<<i))
+        if( insn.Op1.value & (1<<i))
         {
           savedreg_size += 4;
         }
       }
-      //msg("0x%a create_func_frame: detected stmX 0x%a\n", ea, cmd.Op1.value);
+      //msg("0x%a create_func_frame: detected stmX 0x%a\n", ea, insn.Op1.value);
       loopAgain = true;
     }
 
     // detect multiple ``st Ri, @-R15'' instructions.
-    if (cmd.itype == fr_st
-      && cmd.Op1.type == o_reg
-      && cmd.Op2.type == o_phrase
-      && cmd.Op2.reg == rR15
-      && cmd.Op2.specflag2 == fIGRM)
+    if (insn.itype == fr_st
+      && insn.Op1.type == o_reg
+      && insn.Op2.type == o_phrase
+      && insn.Op2.reg == rR15
+      && insn.Op2.specflag2 == fIGRM)
     {
       savedreg_size += 4;
       //msg("0x%a create_func_frame: detected st Rx, @-R15\n", ea);
       loopAgain = true;
     }
     if( loopAgain )
-      ea = cmd.ea + cmd.size;
+      ea = insn.ea + insn.size;
   }
 
   // detect enter #nn
-  if ( cmd.itype == fr_enter )
+  if ( insn.itype == fr_enter )
   {
     // R14 is automatically pushed by fr_enter
     savedreg_size += 4;
-    localvar_size = uint32(cmd.Op1.value - 4);
+    localvar_size = uint32(insn.Op1.value - 4);
     pfn->flags |= FUNC_FRAME;
-    //msg("0x%a create_func_frame: detected enter #0x%a\n", ea, cmd.Op1.value);
+    //msg("0x%a create_func_frame: detected enter #0x%a\n", ea, insn.Op1.value);
   }
   // detect mov R15, R14 + ldi #imm, R0 instructions
   else
   {
-    if ( cmd.itype != fr_mov
-      || cmd.Op1.type != o_reg
-      || cmd.Op1.reg != rR15
-      || cmd.Op2.type != o_reg
-      || cmd.Op2.reg != rR14 )
+    if ( insn.itype != fr_mov
+      || insn.Op1.type != o_reg
+      || insn.Op1.reg != rR15
+      || insn.Op2.type != o_reg
+      || insn.Op2.reg != rR14 )
     {
       goto BAD_FUNC;
     }
 
-    /*ea = */next_insn(ea);
-    if ( (cmd.itype == fr_ldi_20 || cmd.itype == fr_ldi_32)
-      && cmd.Op1.type == o_imm
-      && cmd.Op2.type == o_reg
-      && cmd.Op2.reg == rR0 )
+    /*ea = */next_insn(ea, &insn);
+    if ( (insn.itype == fr_ldi_20 || insn.itype == fr_ldi_32)
+      && insn.Op1.type == o_imm
+      && insn.Op2.type == o_reg
+      && insn.Op2.reg == rR0 )
     {
-      localvar_size = uint32(cmd.Op1.value);
+      localvar_size = uint32(insn.Op1.value);
     }
     else
     {
       goto BAD_FUNC;
     }
-    //msg("0x%a create_func_frame: detected ldi #0x%a, R0\n", ea, cmd.Op1.value);
+    //msg("0x%a create_func_frame: detected ldi #0x%a, R0\n", ea, insn.Op1.value);
   }
 
   //msg("0x%a create_func_frame: add_frame lvar_size: %x sreg_size: %x arg_Size: %x\n", ea, localvar_size, savedreg_size, args_size);
@@ -0,0 +1,98 @@
+#include "fr.hpp"
+
+// Decoded instruction cache.
+//
+// The emulator and the helpers around it decode the same neighbours over
+// and over: emu() looks at the previous instruction of everything that
+// flows, handle_operand() looks one or two instructions ahead for the
+// ldi / call and stack variable idioms, and the backward searches walk
+// back through decode_prev_insn().  The cache keeps the decoded insn_t of
+// the last INSN_CACHE_SIZE addresses, direct-mapped by address.  Lookups
+// decode into a buffer of the caller and never touch cmd, so a helper
+// looking at a neighbour does not have to save and restore it.
+//
+// A snapshot only depends on the bytes at its address, so entries are
+// dropped when bytes are patched or an item is undefined.
+
+#define INSN_CACHE_BITS   12
+#define INSN_CACHE_SIZE   (1 << INSN_CACHE_BITS)
+
+struct insn_cache_entry_t
+{
+  ea_t ea;          // BADADDR: empty
+  int size;         // value returned by fr_ana_insn()
+  insn_t insn;
+};
+
+static insn_cache_entry_t *insn_cache;
+
+inline insn_cache_entry_t &insn_cache_slot(ea_t ea)
+{
+  return insn_cache[(ea >> 1) & (INSN_CACHE_SIZE - 1)];
+}
+
+// decode the instruction at ea into *out, from the cache when possible.
+int fr_decode_insn(ea_t ea, insn_t *out)
+{
+  if ( insn_cache == NULL )
+  {
+    insn_cache = (insn_cache_entry_t *)qalloc(sizeof(insn_cache_entry_t) * INSN_CACHE_SIZE);
+    if ( insn_cache == NULL )
+      nomem("insn_cache");
+    for ( int i = 0; i < INSN_CACHE_SIZE; i++ )
+      insn_cache[i].ea = BADADDR;
+  }
+
+  insn_cache_entry_t &e = insn_cache_slot(ea);
+  if ( e.ea == ea )
+  {
+    FR_STAT_DECODE(false);
+    *out = e.insn;
+    return e.size;
+  }
+
+  FR_STAT_DECODE(true);
+  e.size = fr_ana_insn(ea, &e.insn);
+  e.ea = ea;
+  *out = e.insn;
+  return e.size;
+}
+
+// decode the instruction before ea into *out, as decode_prev_insn() would.
+ea_t fr_decode_prev_insn(ea_t ea, insn_t *out)
+{
+  ea_t prev = prev_not_tail(ea);
+  if ( prev == BADADDR || !isCode(get_flags_novalue(prev)) )
+    return BADADDR;
+  if ( fr_decode_insn(prev, out) == 0 || prev + out->size != ea )
+    return BADADDR;
+  return prev;
+}
+
+// forget the entries for instructions overlapping [start, end).
+void fr_insn_cache_invalidate(ea_t start, ea_t end)
+{
+  if ( insn_cache == NULL || end <= start )
+    return;
+
+  // the longest instruction (ldi:32) is 6 bytes
+  start = start < 6 ? 0 : start - 6;
+  if ( end - start >= INSN_CACHE_SIZE * 2 )
+  {
+    fr_insn_cache_flush();
+    return;
+  }
+  for ( ea_t ea = start & ~1; ea < end; ea += 2 )
+  {
+    insn_cache_entry_t &e = insn_cache_slot(ea);
+    if ( e.ea == ea )
+      e.ea = BADADDR;
+  }
+}
+
+// forget all entries.
+void fr_insn_cache_flush(void)
+{
+  qfree(insn_cache);
+  insn_cache = NULL;
+}
@@ -0,0 +1,226 @@
+#include "fr.hpp"
+#include <algorithm>
+
+// Per-function basic block graph.
+//
+// The emulator, the type helpers, the switch matcher and the constant
+// propagation all need to know where blocks end and which instructions
+// have delay slots.  Instead of decoding around cmd.ea each time, the
+// function is decoded once into a sorted instruction array; blocks are
+// index ranges into it and a branch with a delay slot ends its block
+// after the slot.  The graph of the last function asked for is kept
+// until the function or its bytes change.
+
+#define CFG_MAXINSNS      0x10000       // larger functions have no graph
+
+static fr_cfg_t *cfg;                     // the cached graph or NULL
+static ea_t cfg_func = BADADDR;           // bounds of its function
+static ea_t cfg_end;
+
+// index of the instruction at ea or -1. sequential lookups are O(1).
+int fr_cfg_t::find(ea_t ea) const
+{
+  int n = int(insns.size());
+  if ( hint < n && insns[hint].ea == ea )
+    return hint;
+  if ( hint + 1 < n && insns[hint + 1].ea == ea )
+    return ++hint;
+
+  int lo = 0;
+  int hi = n;
+  while ( lo < hi )
+  {
+    int mid = (lo + hi) / 2;
+    if ( insns[mid].ea < ea )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if ( lo < n && insns[lo].ea == ea )
+  {
+    hint = lo;
+    return lo;
+  }
+  return -1;
+}
+
+static bool ea_less(const fr_cfg_insn_t &a, const fr_cfg_insn_t &b)
+{
+  return a.ea < b.ea;
+}
+
+// convert insn into a record.
+static void make_cfg_insn(fr_cfg_insn_t &ci, const insn_t &insn)
+{
+  memset(&ci, 0, sizeof(ci));
+  ci.ea = insn.ea;
+  ci.size = uchar(insn.size);
+  ci.target = BADADDR;
+
+  uint32 feature = insn.get_canon_feature();
+  if ( (feature & CF_STOP) != 0 )
+    ci.flags |= FR_CFG_STOP | FR_CFG_BRANCH;
+  if ( (feature & CF_CALL) != 0 || insn.itype == fr_int || insn.itype == fr_inte )
+    ci.flags |= FR_CFG_CALL;
+  if ( (insn.auxpref & INSN_DELAY_SHOT) != 0 )
+    ci.flags |= FR_CFG_DELAY;
+  for ( int i = 0; i < UA_MAXOP && insn.Operands[i].type != o_void; i++ )
+  {
+    const op_t &x = insn.Operands[i];
+    if ( x.type == o_near && (feature & CF_CALL) == 0 )
+    {
+      ci.flags |= FR_CFG_BRANCH;
+      ci.target = toEA(insn.cs, x.addr);
+    }
+  }
+}
+
+static fr_cfg_t *build_cfg(func_t *pfn)
+{
+  fr_cfg_t *g = new fr_cfg_t;
+  g->func = pfn->startEA;
+  g->lo = BADADDR;
+  g->hi = 0;
+  g->hint = 0;
+
+  // decode the function
+  qvector<fr_cfg_insn_t> &insns = g->insns;
+  insn_t insn;
+  func_item_iterator_t fii;
+  for ( bool ok = fii.set(pfn); ok; ok = fii.next_code() )
+  {
+    ea_t ea = fii.current();
+    if ( !isCode(get_flags_novalue(ea)) || fr_decode_insn(ea, &insn) == 0 )
+      continue;
+    if ( insns.size() == CFG_MAXINSNS )
+    {
+      delete g;
+      return NULL;
+    }
+    make_cfg_insn(insns.push_back(), insn);
+    g->lo = qmin(g->lo, ea);
+    g->hi = qmax(g->hi, ea + insn.size);
+  }
+  int n = int(insns.size());
+  if ( n == 0 )
+    return g;
+  std::sort(insns.begin(), insns.end(), ea_less);
+
+  // find the leaders: branch targets, instructions after gaps and after
+  // a branch (or its delay slot)
+  qvector<uchar> leader;
+  leader.resize(n, 0);
+  leader[0] = 1;
+  for ( int i = 0; i < n; i++ )
+  {
+    const fr_cfg_insn_t &ci = insns[i];
+    if ( ci.target != BADADDR )
+    {
+      int t = g->find(ci.target);
+      if ( t >= 0 )
+        leader[t] = 1;
+    }
+    if ( i + 1 < n && !g->linked(i + 1) )
+      leader[i + 1] = 1;
+    if ( (ci.flags & FR_CFG_BRANCH) != 0 )
+    {
+      int next = i + ((ci.flags & FR_CFG_DELAY) != 0 ? 2 : 1);
+      if ( next < n )
+        leader[next] = 1;
+    }
+  }
+
+  // make the blocks
+  qvector<fr_cfg_block_t> &blocks = g->blocks;
+  for ( int i = 0; i < n; i++ )
+  {
+    if ( leader[i] )
+    {
+      fr_cfg_block_t &b = blocks.push_back();
+      b.start = i;
+    }
+    blocks.back().end = i + 1;
+    insns[i].block = int(blocks.size()) - 1;
+  }
+  for ( size_t k = 0; k < blocks.size(); k++ )
+  {
+    fr_cfg_block_t &b = blocks[k];
+    b.succ[0] = -1;
+    b.succ[1] = -1;
+    // the branch is the last instruction or the one before its delay slot
+    int last = b.end - 1;
+    const fr_cfg_insn_t *br = &insns[last];
+    if ( (br->flags & FR_CFG_BRANCH) == 0 && last > b.start
+      && (insns[last - 1].flags & (FR_CFG_BRANCH | FR_CFG_DELAY)) == (FR_CFG_BRANCH | FR_CFG_DELAY) )
+    {
+      br = &insns[last - 1];
+    }
+    if ( (br->flags & FR_CFG_BRANCH) != 0 && br->target != BADADDR )
+    {
+      int t = g->find(br->target);
+      if ( t >= 0 )
+        b.succ[0] = insns[t].block;
+    }
+    bool falls = (br->flags & FR_CFG_STOP) == 0;
+    if ( falls && b.end < n && g->linked(b.end) )
+      b.succ[1] = insns[b.end].block;
+  }
+  g->hint = 0;
+  return g;
+}
+
+// the graph of a function, built on first use. NULL if the function is
+// too large.
+const fr_cfg_t *fr_get_cfg(func_t *pfn)
+{
+  if ( pfn == NULL )
+    return NULL;
+  if ( cfg_func != pfn->startEA || cfg_end != pfn->endEA )
+  {
+    fr_cfg_flush();
+    cfg = build_cfg(pfn);
+    cfg_func = pfn->startEA;
+    cfg_end = pfn->endEA;
+  }
+  return cfg;
+}
+
+// the cached graph if it contains the instruction at ea. never builds one.
+const fr_cfg_t *fr_find_cfg(ea_t ea, int *idx)
+{
+  if ( cfg == NULL || ea < cfg->lo || ea >= cfg->hi )
+    return NULL;
+  int i = cfg->find(ea);
+  if ( i < 0 )
+    return NULL;
+  *idx = i;
+  return cfg;
+}
+
+// flags of the instruction flowing into ea, or -1 if the graph does not
+// know it.
+int fr_cfg_prev_flags(ea_t ea)
+{
+  int i;
+  const fr_cfg_t *g = fr_find_cfg(ea, &i);
+  if ( g == NULL || !g->linked(i) )
+    return -1;
+  return g->insns[i - 1].flags;
+}
+
+// forget the graph if it overlaps [start, end).
+void fr_cfg_invalidate(ea_t start, ea_t end)
+{
+  if ( cfg_func == BADADDR )
+    return;
+  bool overlaps = cfg != NULL && start < cfg->hi && end > cfg->lo;
+  if ( overlaps || (start <= cfg_func && end > cfg_func) )
+    fr_cfg_flush();
+}
+
+void fr_cfg_flush(void)
+{
+  delete cfg;
+  cfg = NULL;
+  cfg_func = BADADDR;
+}
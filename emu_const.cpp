@@ -0,0 +1,474 @@
+#include "fr.hpp"
+#include <srarea.hpp>
+
+// Register constant propagation.
+//
+// Tracks the values of R0-R15 which are known to be constant through a
+// function, so that indirect calls and jumps (call @Ri / jmp @Ri) can be
+// resolved no matter how the register was loaded: ldi:8/20/32, mov, add,
+// addn, lsl and or are followed, across delay slots and basic blocks.
+//
+// The instructions of the function's block graph (emu_cfg) are decoded
+// into compact records and its blocks are solved with a worklist.  Only
+// the register values at the indirect call / jump sites are kept; the
+// last function analyzed is cached until it changes.
+
+// what an instruction does to the registers
+enum const_kind_t
+{
+  CK_KILL,          // only kills the registers in 'kills'
+  CK_SET,           // dst = imm
+  CK_MOV,           // dst = src
+  CK_ADD_IMM,       // dst += imm
+  CK_ADD_REG,       // dst += src
+  CK_LSL_IMM,       // dst <<= imm
+  CK_LSL_REG,       // dst <<= src
+  CK_OR_REG,        // dst |= src
+  CK_EXTSB,         // dst = sign extended byte
+  CK_EXTUB,         // dst = zero extended byte
+  CK_EXTSH,         // dst = sign extended halfword
+  CK_EXTUH,         // dst = zero extended halfword
+};
+
+#define CI_DELAY          0x01          // followed by a delay slot
+#define CI_CALL           0x02          // clobbers FR_CALL_SPOILED
+#define CI_SITE           0x04          // call @Ri / jmp @Ri
+#define CI_KNOWN          0x08          // site: the register value is known
+
+struct const_insn_t
+{
+  ea_t ea;
+  uint32 imm;       // CK_SET, CK_ADD_IMM, CK_LSL_IMM; site: resolved value
+  uint16 kills;     // registers written
+  uchar size;
+  uchar kind;       // const_kind_t
+  uchar flags;      // CI_...
+  uchar dst;
+  uchar src;        // site: the register holding the target
+};
+
+// the known register values at some point
+struct reg_state_t
+{
+  uint16 known;
+  uint32 val[16];
+
+  void kill(uint16 mask) { known &= ~mask; }
+  void set(int reg, uint32 v) { known |= 1 << reg; val[reg] = v; }
+  bool has(int reg) const { return (known & (1 << reg)) != 0; }
+  // keep the registers which agree in both states. returns true if changed.
+  bool meet(const reg_state_t &r)
+  {
+    uint16 k = known & r.known;
+    for ( int i = 0; i < 16; i++ )
+      if ( (k & (1 << i)) != 0 && val[i] != r.val[i] )
+        k &= ~(1 << i);
+    bool changed = k != known;
+    known = k;
+    return changed;
+  }
+};
+
+// solver state of a block of the graph
+struct const_block_t
+{
+  bool reached;
+  bool queued;
+  reg_state_t in;
+};
+
+static ea_t const_func = BADADDR;             // function in the cache
+static ea_t const_lo;                         // range of its instructions
+static ea_t const_hi;
+static qvector<const_insn_t> const_insns;    // sites of the cached function
+
+inline bool is_gr(const op_t &x)
+{
+  return x.type == o_reg && x.reg <= rR15;
+}
+
+// convert insn into a record.
+static void make_const_insn(const_insn_t &ci, const insn_t &insn)
+{
+  memset(&ci, 0, sizeof(ci));
+  ci.ea = insn.ea;
+  ci.size = uchar(insn.size);
+  ci.kind = CK_KILL;
+
+  if ( (insn.auxpref & INSN_DELAY_SHOT) != 0 )
+    ci.flags |= CI_DELAY;
+
+  // the call clobbers are applied after a delay slot, see CI_CALL
+  ci.kills = fr_insn_writes(insn);
+
+  switch ( insn.itype )
+  {
+    case fr_ldi_8:
+    case fr_ldi_20:
+    case fr_ldi_32:
+      if ( is_gr(insn.Op2) )
+      {
+        ci.kind = CK_SET;
+        ci.dst = uchar(insn.Op2.reg);
+        ci.imm = fr_ldi_value(insn.itype, uint32(insn.Op1.value));
+      }
+      break;
+
+    case fr_mov:
+      if ( is_gr(insn.Op1) && is_gr(insn.Op2) )
+      {
+        ci.kind = CK_MOV;
+        ci.src = uchar(insn.Op1.reg);
+        ci.dst = uchar(insn.Op2.reg);
+      }
+      break;
+
+    case fr_add:
+    case fr_add2:
+    case fr_addn:
+    case fr_addn2:
+    case fr_lsl:
+    case fr_lsl2:
+    case fr_or:
+      if ( !is_gr(insn.Op2) )
+        break;
+      ci.dst = uchar(insn.Op2.reg);
+      if ( insn.Op1.type == o_imm )
+      {
+        bool shift = insn.itype == fr_lsl || insn.itype == fr_lsl2;
+        if ( insn.itype != fr_or )
+        {
+          ci.kind = shift ? CK_LSL_IMM : CK_ADD_IMM;
+          ci.imm = uint32(insn.Op1.value);
+        }
+      }
+      else if ( is_gr(insn.Op1) )
+      {
+        ci.src = uchar(insn.Op1.reg);
+        ci.kind = insn.itype == fr_or  ? CK_OR_REG
+                : insn.itype == fr_lsl ? CK_LSL_REG
+                :                       CK_ADD_REG;
+      }
+      break;
+
+    case fr_extsb:
+    case fr_extub:
+    case fr_extsh:
+    case fr_extuh:
+      if ( is_gr(insn.Op1) )
+      {
+        ci.dst = uchar(insn.Op1.reg);
+        ci.kind = insn.itype == fr_extsb ? CK_EXTSB
+                : insn.itype == fr_extub ? CK_EXTUB
+                : insn.itype == fr_extsh ? CK_EXTSH
+                :                         CK_EXTUH;
+      }
+      break;
+
+    case fr_call:
+    case fr_int:
+    case fr_inte:
+      ci.flags |= CI_CALL;
+      break;
+  }
+
+  if ( (insn.itype == fr_call || insn.itype == fr_jmp)
+    && insn.Op1.type == o_phrase
+    && insn.Op1.specflag2 == fIGR
+    && insn.Op1.reg <= rR15 )
+  {
+    ci.flags |= CI_SITE;
+    ci.src = uchar(insn.Op1.reg);
+  }
+}
+
+// apply an instruction to a state.
+static void apply(reg_state_t &s, const const_insn_t &ci)
+{
+  int d = ci.dst;
+  bool known = ci.kind == CK_SET
+            || (s.has(d) && ci.kind != CK_MOV && ci.kind != CK_KILL)
+            || (ci.kind == CK_MOV && s.has(ci.src));
+  if ( ci.kind == CK_ADD_REG || ci.kind == CK_LSL_REG || ci.kind == CK_OR_REG )
+    known = known && s.has(ci.src);
+
+  uint32 v = 0;
+  if ( known )
+  {
+    switch ( ci.kind )
+    {
+      case CK_SET:      v = ci.imm;                             break;
+      case CK_MOV:      v = s.val[ci.src];                      break;
+      case CK_ADD_IMM:  v = s.val[d] + ci.imm;                  break;
+      case CK_ADD_REG:  v = s.val[d] + s.val[ci.src];           break;
+      case CK_LSL_IMM:  v = s.val[d] << (ci.imm & 31);          break;
+      case CK_LSL_REG:  v = s.val[d] << (s.val[ci.src] & 31);   break;
+      case CK_OR_REG:   v = s.val[d] | s.val[ci.src];           break;
+      case CK_EXTSB:    v = uint32(int32(int8(s.val[d])));      break;
+      case CK_EXTUB:    v = s.val[d] & 0xFF;                    break;
+      case CK_EXTSH:    v = uint32(int32(int16(s.val[d])));     break;
+      case CK_EXTUH:    v = s.val[d] & 0xFFFF;                  break;
+    }
+  }
+  s.kill(ci.kills);
+  if ( ci.kind != CK_KILL )
+  {
+    s.kill(uint16(1 << d));
+    if ( known )
+      s.set(d, v);
+  }
+}
+
+// walk a block from its entry state. records the values at the sites.
+static void walk_block(
+        reg_state_t &s,
+        const fr_cfg_block_t &b,
+        qvector<const_insn_t> &insns)
+{
+  uint16 pending = 0;   // clobbers of a call:D, applied after its delay slot
+  for ( int i = b.start; i < b.end; i++ )
+  {
+    const_insn_t &ci = insns[i];
+    if ( (ci.flags & CI_SITE) != 0 )
+    {
+      ci.flags &= ~CI_KNOWN;
+      if ( s.has(ci.src) )
+      {
+        ci.flags |= CI_KNOWN;
+        ci.imm = s.val[ci.src];
+      }
+    }
+    apply(s, ci);
+    s.kill(pending);
+    pending = 0;
+    if ( (ci.flags & CI_CALL) != 0 )
+    {
+      if ( (ci.flags & CI_DELAY) != 0 )
+        pending = FR_CALL_SPOILED;
+      else
+        s.kill(FR_CALL_SPOILED);
+    }
+  }
+  s.kill(pending);
+}
+
+static int find_insn(const qvector<const_insn_t> &insns, ea_t ea)
+{
+  int lo = 0;
+  int hi = int(insns.size());
+  while ( lo < hi )
+  {
+    int mid = (lo + hi) / 2;
+    if ( insns[mid].ea < ea )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < int(insns.size()) && insns[lo].ea == ea ? lo : -1;
+}
+
+// find the register values at the sites of a function.
+static void solve_function(func_t *pfn)
+{
+  const fr_cfg_t *g = fr_get_cfg(pfn);
+  if ( g == NULL )
+    return;
+  const_lo = g->lo;
+  const_hi = g->hi;
+
+  // decode the function
+  int n = int(g->insns.size());
+  qvector<const_insn_t> insns;
+  insns.resize(n);
+  bool have_sites = false;
+  insn_t insn;
+  for ( int i = 0; i < n; i++ )
+  {
+    const_insn_t &ci = insns[i];
+    if ( fr_decode_insn(g->insns[i].ea, &insn) != 0 )
+    {
+      make_const_insn(ci, insn);
+    }
+    else
+    {
+      memset(&ci, 0, sizeof(ci));
+      ci.ea = g->insns[i].ea;
+      ci.kills = 0xFFFF;
+    }
+    have_sites |= (ci.flags & CI_SITE) != 0;
+  }
+  if ( !have_sites )
+    return;
+
+  // solve from the entry block. blocks which are only reached through
+  // unresolved jumps start with nothing known.
+  qvector<const_block_t> blocks;
+  blocks.resize(g->blocks.size());
+  qvector<int> work;
+  int entry = g->find(pfn->startEA);
+  if ( entry >= 0 )
+  {
+    int k = g->insns[entry].block;
+    blocks[k].reached = true;
+    blocks[k].queued = true;
+    work.push_back(k);
+  }
+  size_t next_root = 0;
+  for ( ;; )
+  {
+    if ( work.empty() )
+    {
+      while ( next_root < blocks.size() && blocks[next_root].reached )
+        next_root++;
+      if ( next_root == blocks.size() )
+        break;
+      const_block_t &r = blocks[next_root];
+      r.reached = true;
+      r.queued = true;
+      r.in.known = 0;
+      work.push_back(int(next_root));
+    }
+    int k = work.back();
+    work.pop_back();
+    blocks[k].queued = false;
+
+    reg_state_t s = blocks[k].in;
+    walk_block(s, g->blocks[k], insns);
+    for ( int j = 0; j < 2; j++ )
+    {
+      int t = g->blocks[k].succ[j];
+      if ( t < 0 )
+        continue;
+      const_block_t &tb = blocks[t];
+      bool changed;
+      if ( !tb.reached )
+      {
+        tb.reached = true;
+        tb.in = s;
+        changed = true;
+      }
+      else
+      {
+        changed = tb.in.meet(s);
+      }
+      if ( changed && !tb.queued )
+      {
+        tb.queued = true;
+        work.push_back(t);
+      }
+    }
+  }
+
+  // keep the sites
+  for ( int i = 0; i < n; i++ )
+    if ( (insns[i].flags & CI_SITE) != 0 )
+      const_insns.push_back(insns[i]);
+}
+
+// take the sites of a function from its stored results.
+static void load_sites(const fr_func_result_t &r)
+{
+  const_lo = r.lo;
+  const_hi = r.hi;
+  for ( size_t i = 0; i < r.sites.size(); i++ )
+  {
+    const fr_site_t &s = r.sites[i];
+    const_insn_t &ci = const_insns.push_back();
+    memset(&ci, 0, sizeof(ci));
+    ci.ea = s.ea;
+    ci.imm = s.value;
+    ci.flags = s.flags;
+  }
+}
+
+static void store_sites(ea_t func, uint64 hash)
+{
+  fr_func_result_t r;
+  r.hash = hash;
+  r.lo = const_lo;
+  r.hi = const_hi;
+  for ( size_t i = 0; i < const_insns.size(); i++ )
+  {
+    const const_insn_t &ci = const_insns[i];
+    fr_site_t &s = r.sites.push_back();
+    s.ea = ci.ea;
+    s.value = ci.imm;
+    s.flags = ci.flags;
+  }
+  fr_store_put(func, r);
+}
+
+// analyze a function and keep the results for its sites. unchanged
+// functions take them from the database.
+static void analyze_function(func_t *pfn)
+{
+  const_func = pfn->startEA;
+  const_insns.clear();
+  const_lo = BADADDR;
+  const_hi = 0;
+  uint64 hash = fr_func_hash(pfn);
+  const fr_func_result_t *r = fr_store_find(pfn->startEA, hash);
+  if ( r != NULL )
+  {
+    load_sites(*r);
+    return;
+  }
+  solve_function(pfn);
+  store_sites(pfn->startEA, hash);
+}
+
+static const const_insn_t *find_site(func_t *pfn, ea_t ea)
+{
+  if ( const_func != pfn->startEA )
+    analyze_function(pfn);
+  int i = find_insn(const_insns, ea);
+  return i < 0 ? NULL : &const_insns[i];
+}
+
+// the target of the call @Ri / jmp @Ri at ea, if the register value is known.
+bool fr_resolve_indirect(ea_t ea, ea_t *target)
+{
+  func_t *pfn = get_func(ea);
+  if ( pfn == NULL )
+    return false;
+  const const_insn_t *ci = find_site(pfn, ea);
+  if ( ci == NULL || (ci->flags & CI_KNOWN) == 0 )
+    return false;
+  *target = toEA(getSR(ea, rVcs), ci->imm);
+  return true;
+}
+
+// add code xrefs for all the resolved indirect calls / jumps of a function.
+void fr_add_indirect_xrefs(func_t *pfn)
+{
+  analyze_function(pfn);
+  for ( size_t i = 0; i < const_insns.size(); i++ )
+  {
+    const const_insn_t &ci = const_insns[i];
+    if ( (ci.flags & CI_KNOWN) == 0 )
+      continue;
+    ea_t to = toEA(getSR(ci.ea, rVcs), ci.imm);
+    if ( !isEnabled(to) )
+      continue;
+    bool call = (ci.flags & CI_CALL) != 0;
+    add_cref(ci.ea, to, call ? fl_CN : fl_JN);
+  }
+}
+
+// forget the cached function if it overlaps [start, end).
+void fr_const_invalidate(ea_t start, ea_t end)
+{
+  if ( const_func == BADADDR )
+    return;
+  if ( (start < const_hi && end > const_lo)
+    || (start <= const_func && end > const_func) )
+  {
+    fr_const_flush();
+  }
+}
+
+void fr_const_flush(void)
+{
+  const_func = BADADDR;
+  const_insns.clear();
+}
@@ -0,0 +1,99 @@
+#include "fr.hpp"
+
+// Register def masks.
+//
+// The switch, type and constant analyses ask, for every instruction they
+// walk over, which registers it spoils.  Which operands an itype writes
+// is fixed by the feature flags of Instructions[], so they are gathered
+// once at init into a table, with the registers some itypes write without
+// naming them and those a call does not preserve.  The general registers
+// written by an instruction are then a table lookup and a few operand
+// tests, and a spoil check is an AND: no get_spoiled_reg(), no temporary
+// register lists and no shared state.
+
+struct reg_masks_t
+{
+  uchar chg;        // operands written, bit n for Operands[n]
+  uint16 writes;    // registers written whatever the operands
+  uint16 call;      // registers spoiled by the callee
+};
+
+static reg_masks_t reg_masks[fr_last];
+
+void fr_regs_init(void)
+{
+  static const uint32 chg[] = { CF_CHG1, CF_CHG2, CF_CHG3, CF_CHG4 };
+  for ( int i = 0; i < fr_last; i++ )
+  {
+    uint32 feature = Instructions[i].feature;
+    reg_masks_t &m = reg_masks[i];
+    memset(&m, 0, sizeof(m));
+    for ( int n = 0; n < qnumber(chg); n++ )
+      if ( (feature & chg[n]) != 0 )
+        m.chg |= 1 << n;
+    if ( (feature & CF_CALL) != 0 )
+      m.call = FR_CALL_SPOILED;
+
+    switch ( i )
+    {
+      case fr_ldm0:     // and the registers of the list
+      case fr_ldm1:
+      case fr_stm0:
+      case fr_stm1:
+      case fr_addsp:
+      case fr_fldm:
+      case fr_fstm:
+        m.writes = 1 << rR15;
+        break;
+      case fr_enter:
+      case fr_leave:
+        m.writes = (1 << rR14) | (1 << rR15);
+        break;
+    }
+  }
+}
+
+// the general registers written by x itself: its written operands, the
+// registers of @Ri+ and @-Ri, the list of ldm and the implicit ones.
+uint16 fr_insn_writes(const insn_t &x)
+{
+  const reg_masks_t &m = reg_masks[x.itype];
+  uint16 defs = m.writes;
+  for ( int n = 0; n < 4; n++ )
+  {
+    const op_t &op = x.Operands[n];
+    if ( op.reg > rR15 )
+      continue;
+    if ( op.type == o_reg && (m.chg & (1 << n)) != 0 )
+      defs |= 1 << op.reg;
+    else if ( op.type == o_phrase
+           && (op.specflag2 == fIGRP || op.specflag2 == fIGRM) )
+      defs |= 1 << op.reg;
+  }
+  // bit n of the list is r0+n for ldm0, r8+n for ldm1 (see out_reglist)
+  if ( x.itype == fr_ldm0 )
+    defs |= uint16(x.Op1.value & 0xFF);
+  else if ( x.itype == fr_ldm1 )
+    defs |= uint16((x.Op1.value & 0xFF) << 8);
+  return defs;
+}
+
+// the general registers spoiled by x, a call spoiling FR_CALL_SPOILED.
+uint16 fr_insn_defs(const insn_t &x)
+{
+  return fr_insn_writes(x) | reg_masks[x.itype].call;
+}
+
+// does x spoil reg?
+bool fr_insn_spoils(const insn_t &x, uint16 reg)
+{
+  if ( reg <= rR15 )
+    return (fr_insn_defs(x) & (1 << reg)) != 0;
+
+  // dedicated and coprocessor registers only appear as operands
+  const reg_masks_t &m = reg_masks[x.itype];
+  for ( int n = 0; n < 4; n++ )
+    if ( (m.chg & (1 << n)) != 0 && x.Operands[n].is_reg(reg) )
+      return true;
+  return false;
+}
@@ -0,0 +1,79 @@
+#include "fr.hpp"
+
+// Function prologue scanner.
+//
+// On stripped ROMs most functions are only called through ldi:32 and
+// call @Ri, so recursive descent never reaches them.  The scanner reads
+// and classifies each code segment once and queues, in one pass at the
+// end, the starts fr_prologue_at() finds in it (see frscan.cpp).
+
+// the halfwords of a segment and their instruction sizes
+struct scan_buf_t
+{
+  qvector<uchar> bytes;
+  qvector<uchar> sizes;
+  size_t n;                             // halfwords
+};
+
+static bool read_segment(scan_buf_t &sb, const segment_t *s)
+{
+  ea_t start = s->startEA & ~1;
+  sb.n = size_t((s->endEA - start) / 2);
+  if ( sb.n == 0 )
+    return false;
+  sb.bytes.resize(sb.n * 2);
+  sb.sizes.resize(sb.n);
+
+  // unloaded bytes read as 0xBE, which never starts an instruction
+  const size_t chunk = 0x10000;
+  for ( size_t off = 0; off < sb.n * 2; off += chunk )
+  {
+    size_t len = qmin(chunk, sb.n * 2 - off);
+    uchar *p = &sb.bytes[off];
+    if ( !get_many_bytes(start + off, p, len) )
+    {
+      for ( size_t i = 0; i < len; i++ )
+        p[i] = isLoaded(start + off + i) ? get_byte(start + off + i) : 0xBE;
+    }
+  }
+  fr_classify(NULL, &sb.sizes[0], &sb.bytes[0], sb.n);
+  return true;
+}
+
+static void scan_segment(const segment_t *s, qvector<ea_t> &starts)
+{
+  scan_buf_t sb;
+  if ( !read_segment(sb, s) )
+    return;
+  ea_t base = s->startEA & ~1;
+  for ( size_t i = 0; i < sb.n; i++ )
+  {
+    if ( !fr_prologue_at(&sb.bytes[0], &sb.sizes[0], sb.n, i, uint32(base)) )
+      continue;
+
+    ea_t ea = base + i * 2;
+    if ( get_func(ea) != NULL || !isEnabled(ea) )
+      continue;
+    flags_t F = get_flags_novalue(ea);
+    if ( isTail(F) || isData(F) )
+      continue;
+    starts.push_back(ea);
+  }
+}
+
+// scan the code segments for function prologues and queue the functions
+// found. returns their number.
+int fr_scan_prologues(void)
+{
+  qvector<ea_t> starts;
+  for ( int k = 0; k < get_segm_qty(); k++ )
+  {
+    segment_t *s = getnseg(k);
+    if ( s != NULL && (s->type == SEG_CODE || s->type == SEG_NORM) )
+      scan_segment(s, starts);
+  }
+  for ( size_t i = 0; i < starts.size(); i++ )
+    auto_make_proc(starts[i]);
+  msg("FR: prologue scan: %u functions queued\n", uint(starts.size()));
+  return int(starts.size());
+}
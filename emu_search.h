@@ -3,7 +3,7 @@
 class SearchBackwards
 {
 private:
-  virtual bool MatchFunc() { return false; };
+  virtual bool MatchFunc(const insn_t &) { return false; };
 public:
   bool Search(ea_t ea, uint16 reg);
   ea_t match_ea;
@@ -12,34 +12,34 @@ public:
 // used to search for 'mov r14, rX' after finding a 'add2 n, rX'
 class SearchBackwardsForStackAssign : public SearchBackwards
 {
-  virtual bool MatchFunc() {
-    return cmd.itype == fr_mov &&
-      cmd.Op1.type == o_reg &&
-      cmd.Op1.reg == rR14;
+  virtual bool MatchFunc(const insn_t &x) {
+    return x.itype == fr_mov &&
+      x.Op1.type == o_reg &&
+      x.Op1.reg == rR14;
   }
 };
 
 // used to search for 'extsb rX' after finding a 'add r14, rX'
 class SearchBackwardsForExtend : public SearchBackwards
 {
-  virtual bool MatchFunc() {
-    return cmd.itype == fr_extsb ||
-      cmd.itype == fr_extsh;
+  virtual bool MatchFunc(const insn_t &x) {
+    return x.itype == fr_extsb ||
+      x.itype == fr_extsh;
   }
 };
 
 // used to search for 'ldi:8 n, rX' after finding a 'add r14, rX'
 class SearchBackwardsForLdi8 : public SearchBackwards
 {
-  virtual bool MatchFunc() {
-    return cmd.itype == fr_ldi_8;
+  virtual bool MatchFunc(const insn_t &x) {
+    return x.itype == fr_ldi_8;
   }
 };
 
 // used to search for 'ldi:32 n, rX' after finding a 'add r14, rX'
 class SearchBackwardsForLdi32 : public SearchBackwards
 {
-  virtual bool MatchFunc() {
-    return cmd.itype == fr_ldi_32;
+  virtual bool MatchFunc(const insn_t &x) {
+    return x.itype == fr_ldi_32;
   }
 };
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "fr.hpp"
+#include <map>
+
+// Persistent analysis results.
+//
+// The results of the per-function analyses (today the resolved indirect
+// call / jump sites of emu_const) are kept in the "$ fr" netnode, so that
+// reopening or reanalysing a database does not redo them.  Each function
+// record carries a hash of the function's chunks, bytes and instruction
+// heads; a record is only used while the hash matches, so functions whose
+// bytes or bounds changed are analysed again.
+//
+// The records live in memory while the database is open and are written
+// as one blob when the database is saved:
+//
+//      dd      STORE_VERSION
+//      dd      number of functions
+//      for each function, by address:
+//        ea    start (delta from the previous start)
+//        dq    hash
+//        ea    lo, hi - lo                 (range of the instructions)
+//        dd    number of sites
+//        for each site:
+//          dd  ea - lo, value, flags
+
+#define STORE_VERSION     1             // bump when the results change
+#define STORE_TAG         'F'           // blob tag in "$ fr"
+
+typedef std::map<ea_t, fr_func_result_t> store_map_t;
+static store_map_t store;
+static bool store_dirty;
+
+// FNV-1a
+#define HASH_INIT         0xCBF29CE484222325ULL
+#define HASH_PRIME        0x00000100000001B3ULL
+
+static void hash_bytes(uint64 &h, const uchar *p, size_t n)
+{
+  for ( size_t i = 0; i < n; i++ )
+  {
+    h ^= p[i];
+    h *= HASH_PRIME;
+  }
+}
+
+static void hash_dword(uint64 &h, uint32 v)
+{
+  uchar b[4] = { uchar(v), uchar(v >> 8), uchar(v >> 16), uchar(v >> 24) };
+  hash_bytes(h, b, sizeof(b));
+}
+
+// hash of the chunks of a function, their bytes and the instruction heads.
+uint64 fr_func_hash(func_t *pfn)
+{
+  uint64 h = HASH_INIT;
+  uchar buf[0x1000];
+  func_tail_iterator_t fti(pfn);
+  for ( bool ok = fti.main(); ok; ok = fti.next() )
+  {
+    const area_t &a = fti.chunk();
+    hash_dword(h, uint32(a.startEA));
+    hash_dword(h, uint32(a.endEA));
+    for ( ea_t ea = a.startEA; ea < a.endEA; ea += sizeof(buf) )
+    {
+      size_t len = size_t(qmin(ea_t(sizeof(buf)), a.endEA - ea));
+      if ( !get_many_bytes(ea, buf, len) )
+      {
+        for ( size_t i = 0; i < len; i++ )
+          buf[i] = isLoaded(ea + i) ? get_byte(ea + i) : 0;
+      }
+      hash_bytes(h, buf, len);
+    }
+  }
+  func_item_iterator_t fii;
+  for ( bool ok = fii.set(pfn); ok; ok = fii.next_code() )
+    if ( isCode(get_flags_novalue(fii.current())) )
+      hash_dword(h, uint32(fii.current()));
+  return h;
+}
+
+// the stored results of a function if its hash still matches.
+const fr_func_result_t *fr_store_find(ea_t func, uint64 hash)
+{
+  store_map_t::const_iterator p = store.find(func);
+  if ( p == store.end() || p->second.hash != hash )
+    return NULL;
+  return &p->second;
+}
+
+void fr_store_put(ea_t func, const fr_func_result_t &r)
+{
+  store[func] = r;
+  store_dirty = true;
+}
+
+void fr_store_forget(ea_t func)
+{
+  if ( store.erase(func) != 0 )
+    store_dirty = true;
+}
+
+// read the results saved in the database. an unknown version is dropped.
+void fr_store_load(netnode &node)
+{
+  fr_store_flush();
+  size_t size = 0;
+  uchar *blob = (uchar *)node.getblob(NULL, &size, 0, STORE_TAG);
+  if ( blob == NULL )
+    return;
+
+  const uchar *p = blob;
+  const uchar *end = blob + size;
+  uint32 n = 0;
+  if ( unpack_dd(&p, end) == STORE_VERSION )
+    n = unpack_dd(&p, end);
+  ea_t func = 0;
+  for ( uint32 i = 0; i < n && p < end; i++ )
+  {
+    func += unpack_ea(&p, end);
+    fr_func_result_t &r = store[func];
+    r.hash = unpack_dq(&p, end);
+    r.lo = unpack_ea(&p, end);
+    r.hi = r.lo + unpack_ea(&p, end);
+    uint32 nsites = unpack_dd(&p, end);
+    for ( uint32 k = 0; k < nsites && p < end; k++ )
+    {
+      fr_site_t &s = r.sites.push_back();
+      s.ea = r.lo + unpack_dd(&p, end);
+      s.value = unpack_dd(&p, end);
+      s.flags = uchar(unpack_dd(&p, end));
+    }
+  }
+  qfree(blob);
+  store_dirty = false;
+}
+
+// write the results to the database if they changed.
+void fr_store_save(netnode &node)
+{
+  if ( !store_dirty )
+    return;
+
+  size_t size = 10;
+  for ( store_map_t::const_iterator p = store.begin(); p != store.end(); ++p )
+    size += 40 + p->second.sites.size() * 15;
+  qvector<uchar> buf;
+  buf.resize(size);
+  uchar *ptr = &buf[0];
+  uchar *end = ptr + size;
+
+  ptr = pack_dd(ptr, end, STORE_VERSION);
+  ptr = pack_dd(ptr, end, uint32(store.size()));
+  ea_t prev = 0;
+  for ( store_map_t::const_iterator p = store.begin(); p != store.end(); ++p )
+  {
+    ea_t func = p->first;
+    const fr_func_result_t &r = p->second;
+    ptr = pack_ea(ptr, end, func - prev);
+    ptr = pack_dq(ptr, end, r.hash);
+    ptr = pack_ea(ptr, end, r.lo);
+    ptr = pack_ea(ptr, end, r.hi - r.lo);
+    ptr = pack_dd(ptr, end, uint32(r.sites.size()));
+    for ( size_t k = 0; k < r.sites.size(); k++ )
+    {
+      const fr_site_t &s = r.sites[k];
+      ptr = pack_dd(ptr, end, uint32(s.ea - r.lo));
+      ptr = pack_dd(ptr, end, s.value);
+      ptr = pack_dd(ptr, end, s.flags);
+    }
+    prev = func;
+  }
+  QASSERT(10023, ptr <= end);
+
+  node.delblob(0, STORE_TAG);
+  node.setblob(&buf[0], ptr - &buf[0], 0, STORE_TAG);
+  store_dirty = false;
+}
+
+void fr_store_flush(void)
+{
+  store.clear();
+  store_dirty = false;
+}
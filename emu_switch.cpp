@@ -1,20 +1,7 @@
 
 #include "fr.hpp"
 #include "jptcmn.cpp" // "../jptcmn.cpp"
-
-
-THREAD_SAFE AS_PRINTF(1, 2) int swi_msg(const char *format, ...)
-{
-#ifdef FR_SWITCH_DEBUG
-  va_list va;
-  va_start(va, format);
-  int nbytes = vmsg(format, va);
-  va_end(va);
-  return nbytes;
-#else
-  return 0;
-#endif // FR_SWITCH_DEBUG
-}
+#include <map>
 
 // Normal with imm guard
 //ROM:001E6DB6 6                cmp     #COUNT, rD
@@ -47,317 +34,500 @@ THREAD_SAFE AS_PRINTF(1, 2) int swi_msg(const char *format, ...)
 //ROM:000B2504 3                ldi:32  #off_XXXX, rB
 //ROM:000B250A 2                lsl     #2, rC
 //ROM:000B250C 1                ld      @(rC, rB), rA
-//ROM:000B250E 0                jmp     @rA            
-
-static const char roots_fr_jmp[] = { 1, 0 };
-static const char depends_fr_jmp[][2] = { 
-  { 1 },        // 0
-  { 2, 3 },        // 1
-  { 4 },        // 2
-  { 0 },        // 3
-  { -5, -8 },        // 4
-  { 6 },        // 5
-  { -7 },        // 6
-  { -8 },        // 7
-  { 0 },        // 8
+//ROM:000B250E 0                jmp     @rA
+
+// shift on another register, ldi:20 base
+//              lsl     #2, rC
+//              mov     rC, r13
+//              ldi:20  #off_XXXX, rB
+//              ld      @(r13, rB), rA
+//              jmp     @rA
+
+// table address computed with add
+//              ldi:32  #off_XXXX, rB
+//              lsl     #2, rC
+//              add     rB, rC
+//              ld      @rC, rA
+//              jmp     @rA
+
+// halfword table, absolute or relative to the table
+//              lsl     #1, rC          (or add rC, rC)
+//              lduh    @(r13, rB), rA  (or add + lduh @rC, rA)
+//              add     rB, rA          (relative only)
+//              jmp     @rA
+
+// The guard is 'cmp #COUNT, rD' or 'ldi #COUNT, rE ; cmp rE, rD',
+// followed by bnc / bhi to the default or by bc / bls to the table code
+// (the default then being the fall through, often 'ldi:32 #default, rX ;
+// jmp:D @rX').  An add / add2 of rD before the cmp gives the low case.
+//
+// The instructions before the jmp are decoded once, into a window which
+// follows the unique predecessor of each instruction, and every idiom is
+// matched against the window.  The best match wins.
+
+// the instructions executed before the jmp, the jmp first. they are
+// decoded on first use.
+struct sw_window_t
+{
+  insn_t insns[FR_SW_WINDOW];
+  int n;
+  bool done;
+
+  sw_window_t(const insn_t &jmp) : n(1), done(false) { insns[0] = jmp; }
+  const insn_t *get(int i);
+  int find_def(int i, uint16 reg);
+  area_t span(int i) const;
+
+private:
+  bool push(ea_t ea);
+  void extend(void);
 };
 
-class fr_jmp_pattern_t : public jump_pattern_t
+//--------------------------------------------------------------------------
+bool sw_window_t::push(ea_t ea)
 {
-protected:
-  enum { er0 = 1, er1, er2, er3, er4 };
+  if ( n == FR_SW_WINDOW || fr_decode_insn(ea, &insns[n]) == 0 )
+    return false;
+  n++;
+  return true;
+}
 
-  fr_jmp_pattern_t(const char *_roots, const char (*_depends)[2], switch_info_ex_t &_si)
-    : jump_pattern_t(_roots, _depends, _si)
+// the only instruction flowing or jumping to ea, or BADADDR.
+static ea_t unique_pred(ea_t ea)
+{
+  ea_t pred = BADADDR;
+  xrefblk_t xb;
+  for ( bool ok = xb.first_to(ea, XREF_ALL); ok && xb.iscode; ok = xb.next_to() )
   {
-    allow_noflows = false;
+    if ( pred != BADADDR )
+      return BADADDR;
+    pred = xb.from;
   }
+  return pred;
+}
 
-public:
-  virtual void check_spoiled(void);
-  fr_jmp_pattern_t(switch_info_ex_t &_si) : jump_pattern_t(roots_fr_jmp, depends_fr_jmp, _si)
+// add the predecessor of the last instruction. a delayed branch to it
+// comes with its delay slot.
+void sw_window_t::extend(void)
+{
+  ea_t ea = insns[n - 1].ea;
+  ea_t pred = unique_pred(ea);
+  insn_t p;
+  if ( pred == BADADDR || fr_decode_insn(pred, &p) == 0 )
   {
-    allow_noflows = false;
+    done = true;
   }
+  else
+  {
+    ea_t slot = pred + p.size;
+    bool delayed = (p.auxpref & INSN_DELAY_SHOT) != 0 && slot != ea;
+    if ( (delayed && !push(slot)) || !push(pred) )
+      done = true;
+  }
+}
 
-  virtual bool jpi8(void);
-  virtual bool jpi7(void);
-  virtual bool jpi6(void);
-  virtual bool jpi5(void);
-  virtual bool jpi4(void);
-  virtual bool jpi3(void);
-  virtual bool jpi2(void);
-  virtual bool jpi1(void);
-  virtual bool jpi0(void);
-};
-
-//--------------------------------------------------------------------------
-static bool is_reg_spoiled(uint16 reg)
+const insn_t *sw_window_t::get(int i)
 {
-  static uint32 specreg[1];
-
-  const uint32 *spoil_list;
-  size_t spoil_sz;
-    specreg[0] = reg;
-    spoil_list = &specreg[0];
-    spoil_sz = 1;
-
-  int spoiled_idx = get_spoiled_reg(spoil_list, spoil_sz);
-
-  swi_msg("0x%a is_reg_spoiled reg: %d: %d\n", cmd.ea, reg, spoiled_idx);
-
-  return spoiled_idx >= 0;
+  while ( n <= i && !done )
+    extend();
+  return i < n ? &insns[i] : NULL;
 }
 
-
-void fr_jmp_pattern_t::check_spoiled(void)
+// the bytes of the instructions up to i.
+area_t sw_window_t::span(int i) const
 {
-  if ( r[er0] != -1 && is_reg_spoiled(r[er0]) )
-    spoiled[er0] = true;
-  if ( r[er1] != -1 && is_reg_spoiled(r[er1]) )
-    spoiled[er1] = true;
-  if ( r[er2] != -1 && is_reg_spoiled(r[er2]) )
-    spoiled[er2] = true;
+  area_t a(insns[0].ea, insns[0].ea + insns[0].size);
+  for ( int k = 1; k <= i && k < n; k++ )
+  {
+    a.startEA = qmin(a.startEA, insns[k].ea);
+    a.endEA = qmax(a.endEA, insns[k].ea + insns[k].size);
+  }
+  return a;
 }
 
-
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi8(void)
+// the first instruction from i on which sets reg, or -1. calls stop the
+// search.
+int sw_window_t::find_def(int i, uint16 reg)
 {
-  swi_msg("0x%a jpi8 add2    #-MIN, rD\n", cmd.ea);
-  //add2    #-MIN, rD
-
-  swi_msg("type: %d Op1.t %d, Op1.value %d, Op2.t %d, Op2.reg %d\n", 
-    cmd.itype, cmd.Op1.type, cmd.Op1.value, cmd.Op2.type, cmd.Op2.reg);
-
-
-  if ( cmd.itype == fr_add2
-    && cmd.Op1.type == o_imm
-    && cmd.Op2.type == o_reg
-    && cmd.Op2.reg == r[er3] )
+  for ( ; get(i) != NULL; i++ )
   {
-    si.startea = cmd.ea;
-    si.lowcase = (uval_t)(-((int)cmd.Op1.value));
-    return true;
+    if ( (insns[i].get_canon_feature() & CF_CALL) != 0 )
+      return -1;
+    if ( fr_insn_spoils(insns[i], reg) )
+      return i;
   }
-
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
+  return -1;
 }
 
-
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi7(void)
+inline bool is_ldi(const insn_t &x)
 {
-  swi_msg("0x%a jpi7 ldi:8   #COUNT, rE\n", cmd.ea);
-  //ldi:8   #COUNT, rE
+  return fr_is_ldi(x.itype);
+}
 
-  //swi_msg("type: %d Op1.t %d, Op1.value %d, Op2.t %d, Op2.reg %d\n", 
-  //  cmd.itype, cmd.Op1.type, cmd.Op1.value, cmd.Op2.type, cmd.Op2.reg);
+// ldi #v, reg at i?
+static bool get_ldi(sw_window_t &w, int i, uint16 reg, uval_t *v)
+{
+  const insn_t *x = i < 0 ? NULL : w.get(i);
+  if ( x == NULL || !is_ldi(*x) || !x->Op2.is_reg(reg) )
+    return false;
+  *v = fr_ldi_value(x->itype, uint32(x->Op1.value));
+  return true;
+}
 
+// a match
+struct sw_match_t
+{
+  int score;
+  int first;            // window index of the first instruction
+  ea_t table;
+  int esize;            // element size
+  int rel_base;         // register added to the element, or -1
+  uint16 expr;          // the switch expression register
+  uval_t ncases;
+  sval_t lowcase;
+  bool has_default;
+  ea_t defjump;
+
+  void use(int i) { first = qmax(first, i); }
+};
 
-  if ( cmd.itype == fr_ldi_8
-    && cmd.Op1.type == o_imm
-    && cmd.Op2.type == o_reg
-    && cmd.Op2.reg == r[er4] )
+// the default of a bc / bls guard: the fall through, or where it jumps.
+static ea_t fall_through_default(const insn_t &br)
+{
+  insn_t x;
+  ea_t ea = br.ea + br.size;
+  if ( (br.auxpref & INSN_DELAY_SHOT) != 0 && fr_decode_insn(ea, &x) != 0 )
+    ea += x.size;
+  ea_t def = ea;
+  if ( fr_decode_insn(ea, &x) != 0 )
   {
-    si.startea = cmd.ea;
-    si.set_expr(cmd.Op2.reg, cmd.Op2.dtyp);
-    si.ncases = cmd.Op1.value;
-    si.jcases = cmd.Op1.value;
-    return true;
+    if ( x.itype == fr_bra )
+    {
+      def = toEA(x.cs, x.Op1.addr);
+    }
+    else if ( is_ldi(x) && x.Op2.type == o_reg )
+    {
+      uval_t v = fr_ldi_value(x.itype, uint32(x.Op1.value));
+      uint16 reg = x.Op2.reg;
+      ea_t cs = x.cs;
+      if ( fr_decode_insn(ea + x.size, &x) != 0
+        && x.itype == fr_jmp
+        && x.Op1.type == o_phrase
+        && x.Op1.specflag2 == fIGR
+        && x.Op1.reg == reg )
+      {
+        def = toEA(cs, v);
+      }
+    }
   }
-
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
+  return def;
 }
 
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi6(void)
+// match the guard of a switch on reg, or on the register 'src' it was
+// copied from, above window index i.
+static void match_guard(sw_window_t &w, int i, uint16 reg, int src, sw_match_t &m)
 {
-  swi_msg("0x%a jpi6 cmp  #COUNT, rD\n", cmd.ea);
-  //cmp     rE, rD
-  //cmp     #COUNT, rD
-
-  //swi_msg("type: %d Op1.t %d, Op1.value %d, Op2.t %d, Op2.reg %d\n", 
-  //  cmd.itype, cmd.Op1.type, cmd.Op1.value, cmd.Op2.type, cmd.Op2.reg);
-
-
-  if ( cmd.itype == fr_cmp
-    && cmd.Op1.type == o_imm
-    && cmd.Op2.type == o_reg
-    && cmd.Op2.reg == r[er3] )
+  // the nearest conditional branch and the cmp before it
+  int b = i;
+  const insn_t *br;
+  while ( (br = w.get(b)) != NULL && (br->itype < fr_bra || br->itype > fr_bhi) )
+    b++;
+  if ( br == NULL
+    || (br->itype != fr_bnc && br->itype != fr_bhi
+     && br->itype != fr_bc && br->itype != fr_bls) )
   {
-    si.startea = cmd.ea;
-    si.set_expr(cmd.Op2.reg, cmd.Op2.dtyp);
-    si.ncases = cmd.Op1.value;
-    si.jcases = cmd.Op1.value;
-    skip[7] = true;
-    return true;
+    return;
   }
-
-  if ( cmd.itype == fr_cmp
-    && cmd.Op1.type == o_reg
-    && cmd.Op2.type == o_reg
-    && cmd.Op2.reg == r[er3] )
+  const insn_t *cmp = w.get(b + 1);
+  if ( cmp == NULL || cmp->itype != fr_cmp || cmp->Op2.type != o_reg )
+    return;
+  uint16 d = cmp->Op2.reg;
+  if ( d != reg && int(d) != src )
+    return;
+  // the compared register must not change before it is used
+  int def = w.find_def(i, d);
+  if ( def >= 0 && def <= b )
+    return;
+
+  uval_t count;
+  if ( cmp->Op1.type == o_imm )
   {
-    r[er4] = cmd.Op1.reg;
-    si.set_expr(cmd.Op2.reg, cmd.Op2.dtyp);
-    return true;
+    count = cmp->Op1.value;
   }
-
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
-}
-
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi5(void)
-{
-  swi_msg("0x%a jpi5 bnc:D   locret_1E6DD6\n", cmd.ea);
-  //bnc:D   locret_1E6DD6
-
-  if ( cmd.itype == fr_bnc )
+  else
   {
-    si.defjump = toEA(cmd.cs, cmd.Op1.addr);
-    si.flags |= SWI_DEFAULT;
-    return true;
+    int k = cmp->Op1.type == o_reg ? w.find_def(b + 2, cmp->Op1.reg) : -1;
+    if ( !get_ldi(w, k, cmp->Op1.reg, &count) )
+      return;
+    m.use(k);
   }
 
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
-}
-
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi4(void)
-{
-  swi_msg("0x%a jpi4 mov     r4, r13\n", cmd.ea);
-  //mov     r4, r13
-
-  swi_msg("type: %d Op1.t %d, Op1.reg %d, Op2.t %d, Op2.reg %d\n", 
-    cmd.itype, cmd.Op1.type, cmd.Op1.reg, cmd.Op2.type, cmd.Op2.reg);
-
-  if ( cmd.itype == fr_mov 
-    && cmd.Op1.type == o_reg
-    && cmd.Op2.type == o_reg
-    && cmd.Op2.reg == r[er2])
+  // bnc / bhi jump to the default, bc / bls to the table code. the
+  // window must have come through the other edge.
+  ea_t target = toEA(br->cs, br->Op1.addr);
+  int next = (br->auxpref & INSN_DELAY_SHOT) != 0 ? b - 2 : b - 1;
+  bool taken = next >= 0 && w.insns[next].ea == target;
+  bool jumps_out = br->itype == fr_bnc || br->itype == fr_bhi;
+  if ( taken == jumps_out )
+    return;
+  uval_t ncases = br->itype == fr_bhi || br->itype == fr_bls ? count + 1 : count;
+  if ( ncases == 0 || ncases > FR_SW_MAXCASES )
+    return;
+  m.defjump = jumps_out ? target : fall_through_default(*br);
+  m.has_default = true;
+  m.ncases = ncases;
+  m.expr = d;
+  m.use(b + 1);
+  m.score += 2;
+
+  // the low case
+  int add = w.find_def(b + 2, d);
+  const insn_t *x = add < 0 ? NULL : w.get(add);
+  if ( x != NULL
+    && (x->itype == fr_add || x->itype == fr_add2)
+    && x->Op1.type == o_imm
+    && x->Op2.is_reg(d) )
   {
-    r[er3] = cmd.Op1.reg;
-    swi_msg("0x%a r[er3] = %d\n", cmd.ea, r[er2]);
-    si.startea = cmd.ea;
-    si.lowcase = 0;
-    return true;
+    m.lowcase = -sval_t(x->Op1.value);
+    m.use(add);
+    m.score++;
   }
-
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
 }
 
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi3(void)
+// match the index scaled into reg above window index i, and its guard.
+static bool match_index(sw_window_t &w, int i, uint16 reg, sw_match_t &m)
 {
-  swi_msg("0x%a jpi3 ldi:32  #off_XXXXX, r12\n", cmd.ea);
-
-  //ldi:32  #off_28BA40, r12
-
-  if ( cmd.itype == fr_ldi_32 
-    && cmd.Op2.type == o_reg
-    && cmd.Op2.reg == r[er1])
+  bool scaled = false;
+  int src = -1;
+  for ( int steps = 0; steps < 4 && src < 0; steps++ )
   {
-    si.jumps = toEA(cmd.cs, cmd.Op1.value);
-    si.set_jtable_element_size(4);
-    return true;
+    int def = w.find_def(i, reg);
+    if ( def < 0 )
+      break;
+    const insn_t &x = *w.get(def);
+    if ( x.itype == fr_mov && x.Op1.type == o_reg && x.Op2.is_reg(reg) )
+    {
+      // a copy: of the scaled index before the shift, of the expression
+      // after it
+      if ( scaled )
+        src = x.Op1.reg;
+      else
+        reg = x.Op1.reg;
+    }
+    else if ( !scaled
+           && ((x.itype == fr_lsl
+             && x.Op1.type == o_imm
+             && x.Op1.value == (m.esize == 4 ? 2 : 1)
+             && x.Op2.is_reg(reg))
+            || (m.esize == 2
+             && x.itype == fr_add
+             && x.Op1.is_reg(reg)
+             && x.Op2.is_reg(reg))) )
+    {
+      scaled = true;
+    }
+    else
+    {
+      break;
+    }
+    m.use(def);
+    i = def + 1;
   }
+  if ( !scaled )
+    return false;
+  m.expr = reg;
+  m.score++;
+  match_guard(w, i, reg, src, m);
+  return true;
+}
 
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
+// match the table base loaded into reg above window index i.
+static bool match_base(sw_window_t &w, int i, uint16 reg, sw_match_t &m)
+{
+  if ( m.rel_base >= 0 && reg != m.rel_base )
+    return false;
+  int def = w.find_def(i, reg);
+  uval_t v;
+  if ( !get_ldi(w, def, reg, &v) )
+    return false;
+  m.table = toEA(w.insns[0].cs, v);
+  m.use(def);
+  return true;
 }
 
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi2(void)
+// try the idioms for the table load at window index i.
+static void match_load(sw_window_t &w, int i, int rel_base, sw_match_t &best)
 {
-  swi_msg("0x%a jpi2 lsl     #2, r13\n", cmd.ea);
+  const insn_t &ld = *w.get(i);
+  sw_match_t m;
+  memset(&m, 0, sizeof(m));
+  m.esize = ld.itype == fr_ld ? 4 : 2;
+  m.rel_base = rel_base;
 
-  //lsl     #2, r13
-  swi_msg("type: %d Op1.t %d, Op1.v %d, Op2.t %d, Op2.reg %d\n", 
-    cmd.itype, cmd.Op1.type, cmd.Op1.value, cmd.Op2.type, cmd.Op2.reg);
+  if ( ld.Op1.specflag2 == fR13RI )
+  {
+    // ld @(r13, rB), rA
+    if ( match_base(w, i + 1, ld.Op1.reg, m)
+      && match_index(w, i + 1, rR13, m)
+      && m.score > best.score )
+    {
+      best = m;
+    }
+    return;
+  }
 
-  if ( cmd.itype == fr_lsl 
-    && cmd.Op2.type == o_reg
-    && cmd.Op2.reg == rR13
-    && cmd.Op1.type == o_imm
-    && cmd.Op1.value == 2 )
+  // ld @rC, rA with rC = rB + index, in either order
+  int a = w.find_def(i + 1, ld.Op1.reg);
+  const insn_t *add = a < 0 ? NULL : w.get(a);
+  if ( add == NULL
+    || add->itype != fr_add
+    || add->Op1.type != o_reg
+    || !add->Op2.is_reg(ld.Op1.reg) )
   {
-    return true;
+    return;
+  }
+  m.use(a);
+  uint16 regs[2] = { add->Op1.reg, ld.Op1.reg };
+  for ( int k = 0; k < 2; k++ )
+  {
+    sw_match_t t = m;
+    if ( match_base(w, a + 1, regs[k], t)
+      && match_index(w, a + 1, regs[1 - k], t)
+      && t.score > best.score )
+    {
+      best = t;
+    }
   }
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
 }
 
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi1(void)
+// match the idioms against the instructions before the jmp @rA.
+// when the jmp can never be a switch, *dead gets the bytes which decided
+// it; otherwise its start is BADADDR.
+static bool match_switch(const insn_t &jmp, sw_match_t &best, ea_t *start, area_t *dead)
 {
-  swi_msg("0x%a jpi1\n", cmd.ea);
+  memset(&best, 0, sizeof(best));
+  dead->startEA = dead->endEA = BADADDR;
+  if ( jmp.Op1.type != o_phrase || jmp.Op1.specflag2 != fIGR )
+  {
+    *dead = area_t(jmp.ea, jmp.ea + jmp.size);
+    return false;
+  }
 
-  //ld      @(r13, r12), r12
+  sw_window_t w(jmp);
+  uint16 ra = jmp.Op1.reg;
+  int d = w.find_def(1, ra);
+  const insn_t *x = d < 0 ? NULL : w.get(d);
 
-  if ( cmd.itype == fr_ld 
-    && cmd.Op1.type == o_phrase
-    && cmd.Op1.specflag2 == fR13RI
-    && cmd.Op2.is_reg(r[er0]) ) 
+  // halfword offsets from the table: add rB, rA after the load
+  int rel_base = -1;
+  if ( x != NULL && x->itype == fr_add && x->Op1.type == o_reg && x->Op2.is_reg(ra) )
   {
-    r[er1] = cmd.Op1.reg;
-    r[er2] = rR13;
-    swi_msg("0x%a r[er1] = %d\n", cmd.ea, r[er1]);
-    return true;
+    rel_base = x->Op1.reg;
+    d = w.find_def(d + 1, ra);
+    x = d < 0 ? NULL : w.get(d);
+    if ( x != NULL && x->itype != fr_lduh )
+      x = NULL;
   }
 
-  // is ldi:32 XXX, er0, then stop, as it's a normal jump
-  if ( cmd.itype == fr_ldi_32 
-    && cmd.Op2.type == o_reg
-    && cmd.Op2.reg == r[er0])
+  // most jmp @rA are tail calls through ldi:32 and stop here
+  if ( x == NULL
+    || (x->itype != fr_ld && x->itype != fr_lduh)
+    || x->Op1.type != o_phrase
+    || (x->Op1.specflag2 != fR13RI && x->Op1.specflag2 != fIGR)
+    || !x->Op2.is_reg(ra) )
+  {
+    SWI_TRACE(FR_EV_SW_NO_TABLE, jmp.ea, uint32(d), x != NULL ? x->itype : uint32(-1));
+    // no other path can reach the jmp with another rA
+    if ( d >= 0 )
+      *dead = w.span(d);
+    return false;
+  }
+  match_load(w, d, rel_base, best);
+  if ( best.score == 0 || !best.has_default )
   {
-    this->failed = true;
-    swi_msg("0x%a found normal jump, so skip all\n", cmd.ea);
+    SWI_TRACE(FR_EV_SW_NO_MATCH, jmp.ea, best.score, best.has_default);
     return false;
   }
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
+  *start = w.insns[best.first].ea;
+  return true;
 }
 
-//--------------------------------------------------------------------------
-bool fr_jmp_pattern_t::jpi0(void)
-{
-  swi_msg("0x%a jpi0\n", cmd.ea);
+// jmps which can never be switches, with the bytes which decided it.
+// IDA asks again each time the function is reanalysed; the answer only
+// changes when those bytes, or the code xrefs to them which decided how
+// far back the window went, do.
+typedef std::map<ea_t, area_t> nosw_map_t;
+static nosw_map_t nosw;
+static ea_t nosw_before;            // largest jmp - startEA
+static ea_t nosw_after;             // largest endEA - jmp
 
-  //   jmp     @r12
+static void remember_nosw(ea_t jmp, const area_t &a)
+{
+  nosw[jmp] = a;
+  nosw_before = qmax(nosw_before, jmp - a.startEA);
+  nosw_after = qmax(nosw_after, a.endEA - jmp);
+}
 
-  if ( cmd.itype == fr_jmp
-    && cmd.Op1.type == o_phrase
-    && cmd.Op1.specflag2 == fIGR )
+void fr_switch_invalidate(ea_t start, ea_t end)
+{
+  if ( nosw.empty() )
+    return;
+  ea_t lo = start > nosw_after ? start - nosw_after : 0;
+  ea_t hi = end + nosw_before < end ? BADADDR : end + nosw_before;
+  nosw_map_t::iterator p = nosw.lower_bound(lo);
+  while ( p != nosw.end() && p->first < hi )
   {
-    r[er0] = cmd.Op1.reg;
-    swi_msg("0x%a r[er0] = %d\n", cmd.ea, r[er0]);
-
-    return true;
+    if ( p->second.startEA < end && p->second.endEA > start )
+      nosw.erase(p++);
+    else
+      ++p;
   }
-  swi_msg("0x%a false\n", cmd.ea);
-  return false;
 }
 
+void fr_switch_flush(void)
+{
+  nosw.clear();
+  nosw_before = 0;
+  nosw_after = 0;
+}
 
 //----------------------------------------------------------------------
 static jump_table_type_t is_fr_pattern(switch_info_ex_t &si)
 {
-  swi_msg("0x%a is_fr_pattern\n", cmd.ea);
-  fr_jmp_pattern_t jp(si);
-  return jp.match(cmd.ea) ? JT_FLAT32 : JT_NONE;
+  SWI_TRACE(FR_EV_SW_PATTERN, cmd.ea);
+  sw_match_t m;
+  ea_t start;
+  area_t dead;
+  if ( !match_switch(cmd, m, &start, &dead) )
+  {
+    if ( dead.startEA != BADADDR )
+    {
+      SWI_TRACE(FR_EV_SW_DEAD, cmd.ea, uint32(dead.startEA), uint32(dead.endEA));
+      remember_nosw(cmd.ea, dead);
+    }
+    return JT_NONE;
+  }
+
+  si.startea = start;
+  si.jumps = m.table;
+  si.set_jtable_element_size(m.esize);
+  if ( m.rel_base >= 0 )
+  {
+    si.flags |= SWI_ELBASE;
+    si.elbase = m.table;
+  }
+  si.set_expr(m.expr, dt_dword);
+  si.ncases = ushort(m.ncases);
+  si.lowcase = m.lowcase;
+  si.defjump = m.defjump;
+  si.flags |= SWI_DEFAULT;
+  SWI_TRACE(FR_EV_SW_FOUND, cmd.ea, uint32(m.table), uint32(m.ncases), uint32(m.defjump));
+  return m.esize == 4 ? JT_FLAT32 : JT_SWITCH;
 }
 
 //----------------------------------------------------------------------
 static bool check_for_jump1(switch_info_ex_t &si)
 {
-  swi_msg("0x%a check_for_jump1\n", cmd.ea);
-
   static is_pattern_t * const fr_patterns[] =
   {
     is_fr_pattern,
@@ -368,12 +538,16 @@ static bool check_for_jump1(switch_info_ex_t &si)
 //----------------------------------------------------------------------
 bool idaapi fr_is_switch(switch_info_ex_t *si)
 {
+  FR_STAT_SCOPE(FR_ST_IS_SWITCH);
+  FR_SPAN("fr_is_switch", cmd.ea);
   if ( cmd.itype != fr_jmp )
     return false;
+  if ( nosw.find(cmd.ea) != nosw.end() )
+  {
+    SWI_TRACE(FR_EV_SW_CACHED, cmd.ea);
+    return false;
+  }
 
-  swi_msg("0x%a fr_is_switch\n", cmd.ea);
-  insn_t saved = cmd;
-  bool found = check_for_jump1(*si);
-  cmd = saved;
-  return found;
+  SWI_TRACE(FR_EV_SW_CHECK, cmd.ea);
+  return check_for_jump1(*si);
 }
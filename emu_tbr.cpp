@@ -0,0 +1,185 @@
+#include "fr.hpp"
+#include <srarea.hpp>
+
+// TBR tracking.
+//
+// Vector n is the word at TBR + 0x3FC - 4 * n.  TBR is 0x000FFC00 after
+// reset, but firmware often moves the table, sometimes more than once,
+// with 'mov Rx, tbr'.  The value is kept in the virtual segment register
+// rVtbr: emu() sets it after every mov to TBR whose source register was
+// loaded with a constant, and ana() computes the vector addresses of
+// int #n / inte from it.
+//
+// Every table found (the reset one and each TBR value set) is imported in
+// one pass: its vectors become offsets and the handlers are queued as
+// functions.
+
+#define TBR_VECTORS       256
+#define TBR_TABLE_SIZE    (TBR_VECTORS * 4)
+#define TBR_INTE_OFFSET   0x3D8         // vector 9, used by inte
+
+static qvector<uint32> tbr_tables;        // tables imported in this session
+
+// the TBR value at ea.
+uint32 fr_get_tbr(ea_t ea)
+{
+  sel_t v = getSR(ea, rVtbr);
+  return v == BADSEL ? FR_TBR_RESET : uint32(v);
+}
+
+// ana: compute the vector addresses of int #n / inte in x.
+void fr_tbr_fixup(insn_t &x)
+{
+  uint32 tbr = fr_get_tbr(x.ea);
+  if ( x.itype == fr_int )
+  {
+    x.Op1.addr = tbr + 0x3FC - uint32(x.Op1.value) * 4;
+  }
+  else if ( x.itype == fr_inte )
+  {
+    x.Op1.addr = tbr + TBR_INTE_OFFSET;
+    x.Op2.addr = tbr;
+  }
+}
+
+static bool is_handler(ea_t table, ea_t h)
+{
+  if ( h == 0 || (h & 1) != 0 || !isEnabled(h) )
+    return false;
+  if ( h >= table && h < table + TBR_TABLE_SIZE )
+    return false;
+  segment_t *s = getseg(h);
+  return s != NULL && s->type != SEG_DATA && s->type != SEG_BSS;
+}
+
+// emu: data xref to the vector of int #n / inte and a call xref to its
+// handler.
+void fr_add_vector_xrefs(const op_t &op)
+{
+  ea_t slot = op.addr;
+  if ( !isLoaded(slot) || !isLoaded(slot + 3) )
+    return;
+  ua_add_dref(op.offb, slot, dr_R);
+  ea_t h = get_long(slot);
+  if ( is_handler(fr_get_tbr(cmd.ea), h) )
+    ua_add_cref(op.offb, h, fl_CN);
+}
+
+// import the vector table at tbr. returns the number of handlers.
+int fr_import_vectors(uint32 tbr)
+{
+  for ( size_t i = 0; i < tbr_tables.size(); i++ )
+    if ( tbr_tables[i] == tbr )
+      return 0;
+  tbr_tables.push_back(tbr);
+
+  uchar buf[TBR_TABLE_SIZE];
+  if ( !get_many_bytes(tbr, buf, sizeof(buf)) )
+    return 0;
+
+  qvector<ea_t> handlers;
+  for ( int v = 0; v < TBR_VECTORS; v++ )
+  {
+    int off = 0x3FC - v * 4;
+    ea_t slot = tbr + off;
+    const uchar *p = &buf[off];
+    ea_t h = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    if ( !is_handler(tbr, h) || isCode(get_flags_novalue(slot)) )
+      continue;
+
+    doDwrd(slot, 4);
+    op_offset(slot, 0, REF_OFF32);
+
+    // the reset table keeps the plain names
+    char name[MAXNAMELEN];
+    if ( !has_any_name(get_flags_novalue(slot)) )
+    {
+      if ( tbr == FR_TBR_RESET )
+        qsnprintf(name, sizeof(name), "vec_%02X", v);
+      else
+        qsnprintf(name, sizeof(name), "vec_%02X_%X", v, tbr);
+      set_name(slot, name, SN_NOWARN);
+    }
+    if ( !has_any_name(get_flags_novalue(h)) )
+    {
+      if ( tbr == FR_TBR_RESET )
+        qsnprintf(name, sizeof(name), "int_%02X", v);
+      else
+        qsnprintf(name, sizeof(name), "int_%02X_%X", v, tbr);
+      set_name(h, name, SN_NOWARN);
+    }
+    handlers.push_back(h);
+  }
+
+  for ( size_t i = 0; i < handlers.size(); i++ )
+    auto_make_proc(handlers[i]);
+  if ( !handlers.empty() )
+    msg("FR: vector table at %a: %u handlers\n", ea_t(tbr), uint(handlers.size()));
+  return int(handlers.size());
+}
+
+// emu: mov Rx, tbr. if Rx holds a constant, TBR takes that value from the
+// next instruction on.
+void fr_emu_tbr_write(void)
+{
+  if ( cmd.itype != fr_mov
+    || !cmd.Op2.is_reg(rTBR)
+    || cmd.Op1.type != o_reg
+    || cmd.Op1.reg > rR15 )
+  {
+    return;
+  }
+
+  insn_t ldi;
+  bool known = false;
+  uint32 tbr = 0;
+  ea_t def = fr_find_prev_def(cmd.ea, cmd.Op1.reg);
+  if ( def != BADADDR && fr_decode_insn(def, &ldi) != 0
+    && fr_is_ldi(ldi.itype)
+    && ldi.Op1.type == o_imm
+    && ldi.Op2.is_reg(cmd.Op1.reg) )
+  {
+    known = true;
+    tbr = fr_ldi_value(ldi.itype, uint32(ldi.Op1.value));
+  }
+  if ( !known || (tbr & 3) != 0 )
+    return;
+
+  ea_t next = cmd.ea + cmd.size;
+  if ( getSR(next, rVtbr) == tbr )
+    return;
+  split_srarea(next, rVtbr, tbr, SR_auto);
+  // int / inte decoded before have the old vector addresses and their
+  // xrefs point into the old table: reanalyse the new area
+  fr_insn_cache_flush();
+  segreg_t *sr = getSRarea(next);
+  if ( sr != NULL )
+    auto_mark_range(next, sr->endEA, AU_USED);
+  fr_import_vectors(tbr);
+}
+
+// set the reset value of TBR in a new segment.
+void fr_tbr_newseg(segment_t *s)
+{
+  s->defsr[rVtbr - ph.regFirstSreg] = FR_TBR_RESET;
+}
+
+// segments of databases created before TBR was tracked have no reset value.
+void fr_tbr_oldfile(void)
+{
+  for ( int k = 0; k < get_segm_qty(); k++ )
+  {
+    segment_t *s = getnseg(k);
+    sel_t &v = s->defsr[rVtbr - ph.regFirstSreg];
+    if ( v == 0 || v == BADSEL )
+    {
+      v = FR_TBR_RESET;
+      s->update();
+    }
+  }
+}
+
+void fr_tbr_flush(void)
+{
+  tbr_tables.clear();
+}
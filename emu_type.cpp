@@ -2,23 +2,10 @@
 #include <enum.hpp>
 #include "fr.hpp"
 #include "emu_search.h"
+#include <algorithm>
 
 static bool idaapi check_reg_for_stack_offset(ea_t ea, int reg);
 
-
-THREAD_SAFE AS_PRINTF(1, 2) int type_msg(const char *format, ...)
-{
-#ifdef FR_TYPE_DEBUG
-  va_list va;
-  va_start(va, format);
-  int nbytes = vmsg(format, va);
-  va_end(va);
-  return nbytes;
-#else
-  return 0;
-#endif // FR_TYPE_DEBUG
-}
-
 bool fr_create_lvar(const op_t &x, uval_t v)
 {
   //type_msg("0x%a create_lvar op.n %d v: 0x%a op.dtyp: %d\n", cmd.ea, x.n, v, (int)x.dtyp);
@@ -90,13 +77,13 @@ bool calc_fr_arglocs(func_type_data_t *fti)
   int r = 0;
   int n = fti->size();
   int spoff = 0;
-  type_msg("0x%a calc_fr_arglocs n: %d\n", cmd.ea, n);
+  TYPE_TRACE(FR_EV_TY_ARGLOCS, cmd.ea, n);
 
   for ( int i=0; i < n; i++ )
   {
     funcarg_t &fa = fti->at(i);
     size_t a = fa.type.get_size();
-    type_msg("0x%a calc_fr_arglocs i: %d a: %d\n", cmd.ea, i, a);
+    TYPE_TRACE(FR_EV_TY_ARGLOC, cmd.ea, i, uint32(a));
     if ( a == BADSIZE )
       return false;
 
@@ -124,43 +111,13 @@ bool calc_fr_arglocs(func_type_data_t *fti)
   return true;
 }
 
-//-------------------------------------------------------------------------
-// returns:
-//      -1: doesn't spoil anything
-//      -2: spoils everything
-//     >=0: the number of the register which is spoiled
-static int spoils(const uint32 *regs, int n)
-{
-  switch (cmd.itype)
-  {
-  case fr_call:
-    for (int i = 0; i < n; i++)
-    {
-      switch (regs[i]) {
-      case rR0:
-      case rR1:
-      case rR2:
-      case rR3:
-      case rR4:
-      case rR5:
-      case rR6:
-      case rR7:
-      case rR12:
-      case rR13:
-        return i;
-      }
-    }
-  }
-  return get_spoiled_reg(regs, n);
-}
-
 static bool fr_set_op_type(
   const op_t &x,
   const tinfo_t &tif,
   const char *name,
   eavec_t &visited)
 {
-  type_msg("fr_set_op_type x.type %d name: %s\n",x.type, name);
+  TYPE_TRACE(FR_EV_TY_SET_OP, cmd.ea, x.type, x.n);
   tinfo_t type = tif;
 
   switch ( x.type )
@@ -191,7 +148,7 @@ static bool fr_set_op_type(
       //return apply_once_tinfo_and_name(dea, type, name);
     }
   case o_displ:
-    type_msg("fr_set_op_type apply_tinfo_to_stkarg op.value 0x%x op.addr \n",x.value, x.addr);
+    TYPE_TRACE(FR_EV_TY_STKARG, cmd.ea, uint32(x.value), uint32(x.addr));
     return apply_tinfo_to_stkarg(x, x.addr, type, name);
   case o_reg:
     {
@@ -224,18 +181,15 @@ static bool fr_set_op_type(
             continue;
           return fr_set_op_type(cmd.Op1, type, name, visited);
         default:
-          {
-            int code = spoils(&r, 1);
-            if ( code == -1 )
-              continue;
-          }
+          if ( !fr_insn_spoils(cmd, uint16(r)) )
+            continue;
           break;
         }
         break;
       }
       if ( !ok && cmd.ea == pfn->startEA )
       { // reached the function start, this looks like a register argument
-        type_msg("fr_set_op_type add_regarg2\n");
+        TYPE_TRACE(FR_EV_TY_REGARG, pfn->startEA, r);
         add_regarg2(pfn, r, type, name);
         break;
       }
@@ -255,24 +209,28 @@ static bool idaapi set_op_type(op_t &x, const tinfo_t &type, const char *name)
 
 int use_fr_regarg_type(ea_t ea, const funcargvec_t &rargs)
 {
-  type_msg("0x%a use_fr_regarg_type\n", ea);
+  FR_STAT_SCOPE(FR_ST_REGARG_TYPE);
   int idx = -1;
-  if ( decode_insn(ea) )
+  insn_t insn;
+  if ( fr_decode_insn(ea, &insn) )
   {
     //type_msg("0x%a use_fr_regarg_type decoded\n", ea);
-    qvector<uint32> regs;
     int n = rargs.size();
-    regs.resize(n);
     for ( int i=0; i < n; i++ )
-      regs[i] = rargs[i].argloc.reg1();
-
-    idx = spoils(regs.begin(), n);
-    type_msg("use_fr_regarg_type n: %x idx: %x\n", n,  idx);
+    {
+      if ( fr_insn_spoils(insn, uint16(rargs[i].argloc.reg1())) )
+      {
+        idx = i;
+        break;
+      }
+    }
+    TYPE_TRACE(FR_EV_TY_REGARG_USE, ea, n, idx, insn.itype);
     if ( idx >= 0 )
     {
+      // the stack variable and operand type helpers work on cmd
+      cmd = insn;
       tinfo_t type = rargs[idx].type;
       const char *name = rargs[idx].name.begin();
-      type_msg("use_fr_regarg_type idx: %d type: %d name: %s\n", idx, type, name);
 
       switch ( cmd.itype )
       {
@@ -280,7 +238,7 @@ int use_fr_regarg_type(ea_t ea, const funcargvec_t &rargs)
         if( type.is_ptr() &&
             check_reg_for_stack_offset(cmd.ea, rargs[idx].argloc.reg1()))
         {
-          type_msg("stack offset\n");
+          TYPE_TRACE(FR_EV_TY_STKOFF, cmd.ea, uint32(cmd.Op1.value));
           if(may_create_stkvars())
             ua_stkvar2(cmd.Op1, cmd.Op1.value, 0);
 
@@ -295,7 +253,7 @@ int use_fr_regarg_type(ea_t ea, const funcargvec_t &rargs)
               
               if( add_stkvar2(get_func(cmd.ea), name, cmd.Op1.value, flags, &mt, size) == 0 )
               {
-                type_msg("add_stkvar2 failed\n" );
+                TYPE_TRACE(FR_EV_TY_STKVAR_FAIL, cmd.ea, uint32(cmd.Op1.value), 0);
                 struc_t* frame = get_frame(cmd.ea);
 
                 sval_t delta;
@@ -310,7 +268,7 @@ int use_fr_regarg_type(ea_t ea, const funcargvec_t &rargs)
 
                   if( add_stkvar2(get_func(cmd.ea), name, cmd.Op1.value, flags, &mt, size) == 0 )
                   {
-                    type_msg("add_stkvar2 failed again\n" );
+                    TYPE_TRACE(FR_EV_TY_STKVAR_FAIL, cmd.ea, uint32(cmd.Op1.value), 1);
                   }
                 }
               }
@@ -347,7 +305,7 @@ int use_fr_regarg_type(ea_t ea, const funcargvec_t &rargs)
 
 bool calc_fr_retloc(const tinfo_t &tif, cm_t /*cc*/, argloc_t *retloc)
 {
-  type_msg("0%a calc_fr_retloc\n", cmd.ea);
+  TYPE_TRACE(FR_EV_TY_RETLOC, cmd.ea);
   if( tif.is_void() )
     return true;
 
@@ -366,9 +324,14 @@ bool calc_fr_retloc(const tinfo_t &tif, cm_t /*cc*/, argloc_t *retloc)
 
 bool is_basic_block_end(void)
 {
-  type_msg("0%a is_basic_block_end\n", cmd.ea);
+  TYPE_TRACE(FR_EV_TY_BB_END, cmd.ea);
   if ( (cmd.auxpref & INSN_DELAY_SHOT) != 0 )
     return true;
+  // the block graph also ends blocks at branches and branch targets
+  const fr_cfg_t *g = fr_get_cfg(get_func(cmd.ea));
+  int i = g != NULL ? g->find(cmd.ea) : -1;
+  if ( i >= 0 )
+    return g->block_end(i);
   return !isFlow(get_flags_novalue(cmd.ea+cmd.size));
 }
 
@@ -377,18 +340,22 @@ bool is_basic_block_end(void)
 // does the specified address have a delay slot?
 bool idaapi fr_has_delay_slot(ea_t ea)
 {
-  insn_t saved = cmd;
+  const fr_cfg_t *g = fr_get_cfg(get_func(ea));
+  int i = g != NULL ? g->find(ea) : -1;
+  if ( i >= 0 )
+    return (g->insns[i].flags & FR_CFG_DELAY) != 0;
+
+  insn_t insn;
   bool res = false;
 
-  if ( decode_insn(ea) )
+  if ( fr_decode_insn(ea, &insn) )
   {
-    if((cmd.auxpref & INSN_DELAY_SHOT) != 0 )
+    if((insn.auxpref & INSN_DELAY_SHOT) != 0 )
     {
       res =  true;
     }
   }
-  cmd = saved;
-  type_msg("0x%a fr_has_delay_slot %d\n", ea, res);
+  TYPE_TRACE(FR_EV_TY_DELAY, ea, res);
   return res;
 }
 
@@ -413,7 +380,8 @@ void use_fr_arg_types(
   func_type_data_t *fti,
   funcargvec_t *rargs)
 {
-  type_msg("0x%a use_fr_arg_types\n", ea);
+  FR_SPAN("use_fr_arg_types", ea);
+  TYPE_TRACE(FR_EV_TY_ARG_TYPES, ea, uint32(fti->size()), uint32(rargs->size()));
 
   gen_use_arg_tinfos(ea, fti, rargs,
     set_op_type,
@@ -438,46 +406,188 @@ static bool idaapi check_reg_for_stack_offset(ea_t ea, int reg)
 }
 
 
-bool SearchBackwards::Search(ea_t ea, uint16 reg)
+//-------------------------------------------------------------------------
+// Backward register definition lookup.
+//
+// The stack variable idioms search back from an instruction for the
+// nearest one which spoils a register, walking decode_prev_insn() until
+// the function start.  Doing that step by step for every add / add2 is
+// quadratic on large functions, so a summary is kept for the last
+// function searched: its instructions sorted by address, the runs of
+// contiguous code and, for every register, the instructions which spoil
+// it.  A lookup is then a binary search.  Code outside of the summary
+// (e.g. created after it was built) is still walked instruction by
+// instruction.  Either way a search gives up after DEFS_MAXSTEPS
+// instructions.
+
+#define DEFS_MAXINSNS     0x10000       // larger functions are walked
+#define DEFS_MAXSTEPS     1024          // instructions searched back
+#define DEFS_WALKSTEPS    16            // ... before the summary is used
+
+static ea_t defs_func = BADADDR;              // function in the summary
+static ea_t defs_lo;                          // range of its instructions
+static ea_t defs_hi;
+static qvector<ea_t> defs_eas;                // instructions, sorted
+static qvector<int> defs_run;                 // first instruction of the run
+static qvector<int> defs_reg[rR15 + 1];       // instructions spoiling a reg
+
+struct def_insn_t
 {
-  //type_msg("0x%a SearchBackwards::Search %d\n", ea, reg);
-  match_ea = BADADDR;
+  ea_t ea;
+  uint16 spoiled;
+  uchar size;
+};
 
-  func_t *pfn = get_func(ea); 
-  decode_insn(ea);
+static bool def_less(const def_insn_t &a, const def_insn_t &b)
+{
+  return a.ea < b.ea;
+}
 
-  bool ret = false;
+static void build_defs(func_t *pfn)
+{
+  fr_defs_flush();
+  defs_func = pfn->startEA;
+  defs_lo = BADADDR;
+  defs_hi = 0;
+
+  qvector<def_insn_t> insns;
+  insn_t insn;
+  func_item_iterator_t fii;
+  for ( bool ok = fii.set(pfn); ok; ok = fii.next_code() )
+  {
+    ea_t ea = fii.current();
+    if ( !isCode(get_flags_novalue(ea)) || fr_decode_insn(ea, &insn) == 0 )
+      continue;
+    if ( insns.size() == DEFS_MAXINSNS )
+    {
+      insns.clear();
+      break;
+    }
+    def_insn_t &di = insns.push_back();
+    di.ea = ea;
+    di.size = uchar(insn.size);
+    di.spoiled = fr_insn_defs(insn);
+    defs_lo = qmin(defs_lo, ea);
+    defs_hi = qmax(defs_hi, ea + insn.size);
+  }
+  std::sort(insns.begin(), insns.end(), def_less);
 
-  while( decode_prev_insn(cmd.ea ) != BADADDR )
+  // the backward walk stops at the function start and at gaps
+  int n = int(insns.size());
+  defs_eas.resize(n);
+  defs_run.resize(n);
+  for ( int i = 0; i < n; i++ )
   {
-    qvector<uint32> regs;
-    regs.resize(1);
-    regs[0] = reg;
+    const def_insn_t &di = insns[i];
+    defs_eas[i] = di.ea;
+    bool linked = i > 0
+               && insns[i - 1].ea + insns[i - 1].size == di.ea
+               && di.ea != pfn->startEA;
+    defs_run[i] = linked ? defs_run[i - 1] : i;
+    for ( int r = 0; r <= rR15; r++ )
+      if ( (di.spoiled & (1 << r)) != 0 )
+        defs_reg[r].push_back(i);
+  }
+}
 
-    int idx = spoils(regs.begin(), 1);
-    //type_msg(" SearchBackwards::Search spoil idx: %d\n", idx);
+static int find_def_insn(ea_t ea)
+{
+  qvector<ea_t>::const_iterator p = std::lower_bound(defs_eas.begin(), defs_eas.end(), ea);
+  return p != defs_eas.end() && *p == ea ? int(p - defs_eas.begin()) : -1;
+}
 
-    if ( idx >= 0 )
+// find the nearest instruction before ea which spoils reg, the way the
+// decode_prev_insn() loop would.  returns its address or BADADDR if the
+// function start or a gap was reached first or the step budget ran out.
+// Most searches end after a few instructions, so the summary is only
+// built once a search goes further than DEFS_WALKSTEPS.
+static ea_t find_prev_def(func_t *pfn, ea_t ea, uint32 reg)
+{
+  ea_t start = pfn != NULL ? pfn->startEA : BADADDR;
+  bool use_defs = false;
+  int steps = 0;
+  while ( steps < DEFS_MAXSTEPS )
+  {
+    if ( !use_defs && steps >= DEFS_WALKSTEPS && pfn != NULL && reg <= rR15 )
     {
-      if( MatchFunc() )
-      {
-        //type_msg(" SearchBackwards::Search spoil Match %d on %a:\n", reg, cmd.ea);
-        match_ea = cmd.ea;
-        ret = true;
-        break; // while
-      }
-      else // unknown instruction changed the register, stop tracing it
-      {
-        break; // while
-      }
+      if ( defs_func != start )
+        build_defs(pfn);
+      use_defs = true;
+    }
+
+    int i = use_defs ? find_def_insn(ea) : -1;
+    if ( i >= 0 && defs_run[i] < i )
+    {
+      // the last spoiling instruction of the run before i
+      const qvector<int> &defs = defs_reg[reg];
+      qvector<int>::const_iterator p = std::lower_bound(defs.begin(), defs.end(), i);
+      int j = p == defs.begin() ? -1 : p[-1];
+      int k = defs_run[i];
+      if ( j >= k )
+        return i - j <= DEFS_MAXSTEPS - steps ? defs_eas[j] : BADADDR;
+      steps += i - k;
+      ea = defs_eas[k];
+      if ( ea == start )
+        return BADADDR;
+      continue;
     }
 
-    if( cmd.ea == pfn->startEA )
-      break; // while
+    // not in the summary or at the start of a run: one step back
+    insn_t insn;
+    ea_t prev = fr_decode_prev_insn(ea, &insn);
+    if ( prev == BADADDR )
+      return BADADDR;
+    steps++;
+    if ( fr_insn_spoils(insn, uint16(reg)) )
+      return prev;
+    if ( prev == start )
+      return BADADDR;
+    ea = prev;
   }
+  return BADADDR;
+}
 
-  // restore correct cmd.*
-  decode_insn(ea);
-  return ret;
+// the nearest instruction before ea which spoils reg, or BADADDR.
+ea_t fr_find_prev_def(ea_t ea, uint32 reg)
+{
+  FR_STAT_SCOPE(FR_ST_SEARCH);
+  return find_prev_def(get_func(ea), ea, reg);
 }
 
+// forget the summary if it covers [start, end).
+void fr_defs_invalidate(ea_t start, ea_t end)
+{
+  if ( defs_func == BADADDR )
+    return;
+  if ( (start < defs_hi && end > defs_lo)
+    || (start <= defs_func && end > defs_func) )
+  {
+    fr_defs_flush();
+  }
+}
+
+void fr_defs_flush(void)
+{
+  defs_func = BADADDR;
+  defs_eas.clear();
+  defs_run.clear();
+  for ( int r = 0; r <= rR15; r++ )
+    defs_reg[r].clear();
+}
+
+bool SearchBackwards::Search(ea_t ea, uint16 reg)
+{
+  FR_STAT_SCOPE(FR_ST_SEARCH);
+  //type_msg("0x%a SearchBackwards::Search %d\n", ea, reg);
+  match_ea = BADADDR;
+
+  insn_t insn;
+  ea_t def = find_prev_def(get_func(ea), ea, reg);
+  bool ret = def != BADADDR && fr_decode_insn(def, &insn) != 0 && MatchFunc(insn);
+  if ( ret )
+  {
+    //type_msg(" SearchBackwards::Search spoil Match %d on %a:\n", reg, def);
+    match_ea = def;
+  }
+  return ret;
+}
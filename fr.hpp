@@ -10,10 +10,17 @@
 //#define JUMP_DEBUG
 //#define FR_TYPE_DEBUG
 //#define FR_SWITCH_DEBUG
+//#define FR_STATS          // callback counters, see stats.cpp
+//#define FR_TIMELINE       // analysis timeline, see timeline.cpp
+
+#if defined(FR_SWITCH_DEBUG) || defined(FR_TYPE_DEBUG)
+#define FR_TRACE                // trace ring, see trace.cpp
+#endif
 
 
 #include "idaidp.hpp" // "../idaidp.hpp"
-#include "ins.hpp"
+#include "frdec.hpp"
+#include "frtrace.hpp"
 #include <diskio.hpp>
 #include <frame.hpp>
 #include <typeinf.hpp>
@@ -23,124 +30,13 @@
 // uncomment this for the final release
 //#define __DEBUG__
 
-// FR registers
-enum fr_registers {
-
-    // general purpose registers :
-
-    rR0,
-    rR1,
-    rR2,
-    rR3,
-    rR4,
-    rR5,
-    rR6,
-    rR7,
-    rR8,
-    rR9,
-    rR10,
-    rR11,
-    rR12,
-    rR13,
-    rR14,
-    rR15,
-
-    // coprocessor registers :
-
-    rCR0,
-    rCR1,
-    rCR2,
-    rCR3,
-    rCR4,
-    rCR5,
-    rCR6,
-    rCR7,
-    rCR8,
-    rCR9,
-    rCR10,
-    rCR11,
-    rCR12,
-    rCR13,
-    rCR14,
-    rCR15,
-
-    // dedicated registers :
-
-    rPC,        // program counter
-    rPS,        // program status
-    rTBR,       // table base register
-    rRP,        // return pointer
-    rSSP,       // system stack pointer
-    rUSP,       // user stack pointer
-    rMDL,       // multiplication/division register (LOW)
-    rMDH,       // multiplication/division register (HIGH)
-
-    // These aren't used on FR65 and below.
-    rBP,        // Base pointer for shorter addressing modes
-    rFCR,       // FPU control register
-    rESR,       // Exception status register
-
-    // system use dedicated registers
-    rReserved9,
-    rReserved10,
-    rReserved11,
-    rReserved12,
-    rReserved13,
-    rReserved14,
-    rReserved15,
-    rDBR,       // Debug register
-
-
-    // Floating point registers (FR81+)
-    rFR0,
-    rFR1,
-    rFR2,
-    rFR3,
-    rFR4,
-    rFR5,
-    rFR6,
-    rFR7,
-    rFR8,
-    rFR9,
-    rFR10,
-    rFR11,
-    rFR12,
-    rFR13,
-    rFR14,
-    rFR15,
-    
-    // these 2 registers are required by the IDA kernel :
-    rVcs,
-    rVds
-};
-
+extern instruc_t Instructions[];
 
 extern const char *const savedRegNames[];
 
-enum fr_phrases {
-    fIGR,       // indirect general register
-    fIRA,       // indirect relative address
-    fIGRP,      // indirect general register with post-increment
-    fIGRM,      // indirect general register with pre-decrement
-    fR13RI,     // indirect displacement between R13 and a general register
-};
-
 // shortcut for a new operand type
 #define o_reglist              o_idpspec0
 
-// flags for insn.auxpref
-#define INSN_DELAY_SHOT        0x00000001           // postfix insn mnem by ":D"
-#define INSN_BAD_DELAY         0x00000002           // This is a bad instruction for delay slots
-
-// flags for opt.specflag1
-#define OP_DISPL_IMM_R14       0x00000001           // @(R14, #i)
-#define OP_DISPL_IMM_R15       0x00000002           // @(R15, #u)
-#define OP_IMM_SIGNED          0x00000020           // IMM signed.
-#define OP_ADDR_R              0x00000010           // read-access to memory
-#define OP_ADDR_W              0x00000012           // write-access to memory
-#define OP_OFFSET_TBR          0x00000040           // Display an interrupt address relative to the TBR (default 0xFFC00)
-#define OP_DISPL_IMM_BP        0x00000080           // @(BP, #u)
-
 inline bool op_displ_imm_r14(const op_t &op) { return (op.specflag1 & OP_DISPL_IMM_R14) != 0; }
 inline bool op_displ_imm_r15(const op_t &op) { return (op.specflag1 & OP_DISPL_IMM_R15) != 0; }
 inline bool op_displ_imm_tbr(const op_t &op) { return (op.specflag1 & OP_OFFSET_TBR) != 0; }
@@ -161,8 +57,144 @@ int idaapi get_frame_retsize(func_t *pfn);
 int idaapi is_sp_based(const op_t &x);
 int idaapi is_align_insn(ea_t ea);
 
+// ana: decoder and bulk pre-decoder
+int fr_ana_insn(ea_t ea, insn_t *x);
+void fr_predecode_range(ea_t start, ea_t end);
+void fr_predecode_invalidate(ea_t start, ea_t end);
+void fr_predecode_flush(void);
+
+// emu_cache: decoded instruction cache
+int fr_decode_insn(ea_t ea, insn_t *out);
+ea_t fr_decode_prev_insn(ea_t ea, insn_t *out);
+void fr_insn_cache_invalidate(ea_t start, ea_t end);
+void fr_insn_cache_flush(void);
+
+// emu_cfg: per-function basic block graph
+#define FR_CFG_STOP       0x01          // no flow to the next instruction
+#define FR_CFG_BRANCH     0x02          // ends a basic block
+#define FR_CFG_DELAY      0x04          // followed by a delay slot
+#define FR_CFG_CALL       0x08          // call / int / inte
+
+struct fr_cfg_insn_t
+{
+  ea_t ea;
+  ea_t target;      // branch target or BADADDR
+  int block;        // the block containing it
+  uchar size;
+  uchar flags;      // FR_CFG_...
+};
+
+struct fr_cfg_block_t
+{
+  int start;        // first instruction
+  int end;          // past the last instruction
+  int succ[2];      // branch target and fall through blocks, -1 if none
+};
+
+struct fr_cfg_t
+{
+  ea_t func;                        // function start
+  ea_t lo;                          // range of the instructions
+  ea_t hi;
+  qvector<fr_cfg_insn_t> insns;     // sorted by address
+  qvector<fr_cfg_block_t> blocks;   // sorted by address
+  mutable int hint;                 // last instruction found
+
+  int find(ea_t ea) const;
+  // does instruction i-1 flow into instruction i?
+  bool linked(int i) const
+  {
+    return i > 0
+        && insns[i - 1].ea + insns[i - 1].size == insns[i].ea
+        && insns[i].ea != func;
+  }
+  // is instruction i the last of its block?
+  bool block_end(int i) const { return blocks[insns[i].block].end == i + 1; }
+};
+
+const fr_cfg_t *fr_get_cfg(func_t *pfn);
+const fr_cfg_t *fr_find_cfg(ea_t ea, int *idx);
+int fr_cfg_prev_flags(ea_t ea);
+void fr_cfg_invalidate(ea_t start, ea_t end);
+void fr_cfg_flush(void);
+
+// emu_regs: register def masks
+void fr_regs_init(void);
+uint16 fr_insn_writes(const insn_t &x);
+uint16 fr_insn_defs(const insn_t &x);
+bool fr_insn_spoils(const insn_t &x, uint16 reg);
+
+// emu_const: register constant propagation
+bool fr_resolve_indirect(ea_t ea, ea_t *target);
+void fr_add_indirect_xrefs(func_t *pfn);
+void fr_const_invalidate(ea_t start, ea_t end);
+void fr_const_flush(void);
+
+// emu_scan: function prologue scanner
+int fr_scan_prologues(void);
+
+// emu_tbr: TBR tracking and vector tables
+uint32 fr_get_tbr(ea_t ea);
+void fr_tbr_fixup(insn_t &x);
+void fr_add_vector_xrefs(const op_t &op);
+int fr_import_vectors(uint32 tbr);
+void fr_emu_tbr_write(void);
+void fr_tbr_newseg(segment_t *s);
+void fr_tbr_oldfile(void);
+void fr_tbr_flush(void);
+
+// emu_store: persistent per-function analysis results
+struct fr_site_t
+{
+  ea_t ea;          // call @Ri / jmp @Ri
+  uint32 value;     // the register value if known
+  uchar flags;      // emu_const flags
+};
+
+struct fr_func_result_t
+{
+  uint64 hash;                      // fr_func_hash() when analyzed
+  ea_t lo;                          // range of the instructions
+  ea_t hi;
+  qvector<fr_site_t> sites;         // sorted by address
+};
+
+uint64 fr_func_hash(func_t *pfn);
+const fr_func_result_t *fr_store_find(ea_t func, uint64 hash);
+void fr_store_put(ea_t func, const fr_func_result_t &r);
+void fr_store_forget(ea_t func);
+void fr_store_load(netnode &node);
+void fr_store_save(netnode &node);
+void fr_store_flush(void);
+
+// devdb: compiled device database
+struct fr_devblock_t
+{
+  ea_t start;
+  ea_t end;
+  const char *name;
+};
+
+struct fr_device_t
+{
+  qvector<ioport_t> ports;          // sorted by address
+  qvector<ioport_t> ints;           // interrupt vectors
+  qvector<fr_devblock_t> blocks;    // IO areas, sorted by address
+};
+
+const fr_device_t *fr_find_device(const char *cfgfile, const char *dev);
+void fr_devdb_flush(void);
+
+// ioindex: I/O port index
+void fr_index_ports(const ioport_t *ports, size_t numports, const fr_device_t *dev);
+const ioport_t *fr_find_port(ea_t ea);
+const char *fr_find_port_block(ea_t ea, uval_t *off);
+void fr_ports_flush(void);
+
 // emu_switch
 bool idaapi fr_is_switch(switch_info_ex_t *si);
+void fr_switch_invalidate(ea_t start, ea_t end);
+void fr_switch_flush(void);
 
 // emu_type
 bool fr_create_lvar(const op_t &x, uval_t v);
@@ -173,6 +205,91 @@ bool calc_fr_retloc(const tinfo_t &tif, cm_t cc, argloc_t *retloc);
 bool is_basic_block_end(void);
 void use_fr_arg_types(ea_t ea, func_type_data_t *fti, funcargvec_t *rargs);
 int get_fr_fastcall_regs(const int **regs);
+ea_t fr_find_prev_def(ea_t ea, uint32 reg);
+void fr_defs_invalidate(ea_t start, ea_t end);
+void fr_defs_flush(void);
+
+// stats: callback counters
+enum fr_stat_id_t
+{
+  FR_ST_ANA,
+  FR_ST_EMU,
+  FR_ST_OUT,
+  FR_ST_OUTOP,
+  FR_ST_IS_SWITCH,
+  FR_ST_FUNC_FRAME,
+  FR_ST_REGARG_TYPE,
+  FR_ST_SEARCH,
+  FR_ST_LAST
+};
+
+#ifdef FR_STATS
+struct fr_stat_scope_t
+{
+  fr_stat_scope_t(fr_stat_id_t _id);
+  ~fr_stat_scope_t(void);
+  fr_stat_id_t id;
+  uint64 start;
+  fr_stat_scope_t *outer;
+};
+void fr_stat_decode(bool miss);
+void fr_stats_report(void);
+void fr_stats_set_file(const char *file);
+#define FR_STAT_SCOPE(id)     fr_stat_scope_t fr_stat_scope(id)
+#define FR_STAT_DECODE(miss)  fr_stat_decode(miss)
+#else
+#define FR_STAT_SCOPE(id)
+#define FR_STAT_DECODE(miss)
+inline void fr_stats_report(void) {}
+inline void fr_stats_set_file(const char *) {}
+#endif
+
+// trace: binary trace ring
+#ifdef FR_TRACE
+void fr_trace(fr_trace_event_t event, ea_t ea, uint32 a = 0, uint32 b = 0, uint32 c = 0);
+void fr_trace_flush(void);
+void fr_trace_poll(void);
+void fr_trace_close(void);
+void fr_trace_set_file(const char *file);
+#else
+inline void fr_trace_flush(void) {}
+inline void fr_trace_poll(void) {}
+inline void fr_trace_close(void) {}
+inline void fr_trace_set_file(const char *) {}
+#endif
+#ifdef FR_SWITCH_DEBUG
+#define SWI_TRACE(...)    fr_trace(__VA_ARGS__)
+#else
+#define SWI_TRACE(...)
+#endif
+#ifdef FR_TYPE_DEBUG
+#define TYPE_TRACE(...)   fr_trace(__VA_ARGS__)
+#else
+#define TYPE_TRACE(...)
+#endif
+
+// timeline: Chrome trace spans of the analysis entry points
+#ifdef FR_TIMELINE
+struct fr_span_t
+{
+  fr_span_t(const char *_name, ea_t _ea);
+  ~fr_span_t(void);
+  const char *name;
+  ea_t ea;
+  uint64 start;
+};
+void fr_timeline_flush(void);
+void fr_timeline_close(void);
+void fr_timeline_set_file(const char *file);
+void fr_timeline_set_min_us(uval_t us);
+#define FR_SPAN(name, ea)   fr_span_t fr_span(name, ea)
+#else
+#define FR_SPAN(name, ea)
+inline void fr_timeline_flush(void) {}
+inline void fr_timeline_close(void) {}
+inline void fr_timeline_set_file(const char *) {}
+inline void fr_timeline_set_min_us(uval_t) {}
+#endif
 
 extern char device[];
 
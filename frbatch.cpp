@@ -0,0 +1,963 @@
+// Headless batch analysis of raw FR ROM images.
+//
+// Runs the decoder (fr_decode) over many ROMs without IDA and writes, for
+// every ROM, the functions, code xrefs and switch tables it finds as JSON
+// or CSV.  The analysis follows the module's: vectors from the TBR table,
+// the prologue scan of frscan.cpp, recursive descent through branches,
+// delay slots, direct calls and ldi + call @Ri, and the jmp @Ri table
+// idioms of emu_switch.cpp that fit in one run of code.
+//
+//       make -f frdec.mak frbatch
+//       ./obj_frdec/frbatch [-j threads] [-b base] [-t tbr] [-e entry]...
+//                           [-f json|csv] [-o dir] rom.bin[@base]...
+//
+// Each ROM is one segment loaded at its base.  The segments are split in
+// chunks for the classification and the prologue scan, and every function
+// is a task of its own; the tasks of all the ROMs run on one work stealing
+// pool with a thread per core.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frdec.hpp"
+
+#define CHUNK_HALFWORDS   0x8000        // halfwords per classify / scan task
+#define MAX_FUNC_INSNS    0x10000       // instructions decoded per function
+
+//--------------------------------------------------------------------------
+// Work stealing pool.
+//
+// Every worker owns a deque: it pushes and pops its own tasks at the
+// back and, when it runs dry, steals from the front of the others.  Tasks
+// submitted from outside are dealt round robin.  wait() returns when no
+// task is queued or running.
+class pool_t
+{
+public:
+  typedef std::function<void(void)> task_t;
+
+  explicit pool_t(int n);
+  ~pool_t();
+  void submit(task_t t);
+  void wait(void);
+
+private:
+  struct queue_t
+  {
+    std::mutex lock;
+    std::deque<task_t> tasks;
+  };
+
+  std::vector<std::unique_ptr<queue_t> > queues;
+  std::vector<std::thread> threads;
+  std::mutex lock;                      // for sleeping and waiting
+  std::condition_variable work;
+  std::condition_variable idle;
+  std::atomic<long> pending;            // queued or running
+  std::atomic<unsigned> next;
+  bool stop;
+
+  static thread_local int self;         // queue of the current worker or -1
+
+  bool take(int q, task_t &t);
+  void run(int q);
+};
+
+thread_local int pool_t::self = -1;
+
+pool_t::pool_t(int n) : pending(0), next(0), stop(false)
+{
+  for ( int i = 0; i < n; i++ )
+    queues.push_back(std::unique_ptr<queue_t>(new queue_t));
+  for ( int i = 0; i < n; i++ )
+    threads.push_back(std::thread(&pool_t::run, this, i));
+}
+
+pool_t::~pool_t()
+{
+  {
+    std::lock_guard<std::mutex> g(lock);
+    stop = true;
+  }
+  work.notify_all();
+  for ( size_t i = 0; i < threads.size(); i++ )
+    threads[i].join();
+}
+
+void pool_t::submit(task_t t)
+{
+  int q = self >= 0 ? self : int(next++ % queues.size());
+  pending++;
+  {
+    std::lock_guard<std::mutex> g(queues[q]->lock);
+    queues[q]->tasks.push_back(std::move(t));
+  }
+  std::lock_guard<std::mutex> g(lock);
+  work.notify_one();
+}
+
+// pop from our own queue, else steal from another one.
+bool pool_t::take(int q, task_t &t)
+{
+  size_t n = queues.size();
+  for ( size_t k = 0; k < n; k++ )
+  {
+    queue_t &src = *queues[(q + k) % n];
+    std::lock_guard<std::mutex> g(src.lock);
+    if ( src.tasks.empty() )
+      continue;
+    if ( k == 0 )
+    {
+      t = std::move(src.tasks.back());
+      src.tasks.pop_back();
+    }
+    else
+    {
+      t = std::move(src.tasks.front());
+      src.tasks.pop_front();
+    }
+    return true;
+  }
+  return false;
+}
+
+void pool_t::run(int q)
+{
+  self = q;
+  for ( ;; )
+  {
+    task_t t;
+    if ( take(q, t) )
+    {
+      t();
+      if ( --pending == 0 )
+      {
+        std::lock_guard<std::mutex> g(lock);
+        idle.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> g(lock);
+    if ( stop )
+      return;
+    // a task may have been queued since take() looked
+    work.wait_for(g, std::chrono::milliseconds(1));
+  }
+}
+
+void pool_t::wait(void)
+{
+  std::unique_lock<std::mutex> g(lock);
+  while ( pending != 0 )
+    idle.wait_for(g, std::chrono::milliseconds(10));
+}
+
+//--------------------------------------------------------------------------
+// A ROM and what is found in it.
+
+#define XR_CALL           0             // call, call @Ri, int
+#define XR_JUMP           1             // branch, tail jmp @Ri
+#define XR_SWITCH         2             // switch table entry
+#define XR_VECTOR         3             // TBR vector
+
+static const char *const xref_names[] = { "call", "jump", "switch", "vector" };
+
+struct xref_t
+{
+  uint32_t from;
+  uint32_t to;
+  int type;                             // XR_...
+
+  bool operator<(const xref_t &r) const
+  {
+    return from != r.from ? from < r.from : to != r.to ? to < r.to : type < r.type;
+  }
+};
+
+struct switch_t
+{
+  uint32_t jmp;
+  uint32_t table;
+  int esize;                            // 4: addresses, 2: offsets from the table
+  uint32_t lowcase;
+  uint32_t ncases;
+  uint32_t defjump;
+  std::vector<uint32_t> targets;
+};
+
+struct function_t
+{
+  uint32_t start;
+  uint32_t end;                         // past the highest instruction
+  uint32_t ninsns;
+};
+
+struct rom_t
+{
+  std::string path;
+  uint32_t base;
+  std::vector<uint8_t> bytes;
+  std::vector<uint8_t> sizes;           // fr_classify() sizes per halfword
+
+  std::mutex lock;                      // for the members below
+  std::set<uint32_t> starts;            // functions claimed
+  std::vector<function_t> funcs;
+  std::vector<xref_t> xrefs;
+  std::vector<switch_t> switches;
+
+  uint32_t end(void) const { return uint32_t(base + bytes.size()); }
+  bool contains(uint32_t ea) const { return ea - base < bytes.size(); }
+  size_t nhw(void) const { return bytes.size() / 2; }
+  uint32_t dword(uint32_t ea) const
+  {
+    const uint8_t *p = &bytes[ea - base];
+    return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+  }
+  int decode(fr_insn_t *insn, uint32_t ea) const
+  {
+    if ( !contains(ea) || (ea & 1) != 0 )
+      return 0;
+    size_t len = std::min(size_t(FR_MAXSIZE), size_t(end() - ea));
+    int size = fr_decode(insn, ea, &bytes[ea - base], len);
+    return size > 0 ? size : 0;
+  }
+};
+
+static pool_t *pool;
+static uint32_t tbr = FR_TBR_RESET;
+static std::vector<uint32_t> entries;   // -e
+
+static void analyze_function(rom_t *rom, uint32_t start);
+
+// queue a function unless it is known already.
+static void add_function(rom_t *rom, uint32_t ea)
+{
+  if ( !rom->contains(ea) || (ea & 1) != 0 )
+    return;
+  {
+    std::lock_guard<std::mutex> g(rom->lock);
+    if ( !rom->starts.insert(ea).second )
+      return;
+  }
+  pool->submit([rom, ea] { analyze_function(rom, ea); });
+}
+
+//--------------------------------------------------------------------------
+// Classification and prologue scan (frscan.cpp).
+
+static void classify_chunk(rom_t *rom, size_t first, size_t n)
+{
+  fr_classify(NULL, &rom->sizes[first], &rom->bytes[2 * first], n);
+}
+
+static void scan_chunk(rom_t *rom, size_t first, size_t n)
+{
+  for ( size_t i = first; i < first + n; i++ )
+  {
+    if ( fr_prologue_at(&rom->bytes[0], &rom->sizes[0], rom->nhw(), i, rom->base) )
+      add_function(rom, uint32_t(rom->base + 2 * i));
+  }
+}
+
+// the vectors of the TBR table which point into the ROM.
+static void import_vectors(rom_t *rom)
+{
+  std::vector<xref_t> xrefs;
+  for ( int n = 0; n < 256; n++ )
+  {
+    uint32_t slot = tbr + 0x3FC - 4 * n;
+    if ( !rom->contains(slot) || !rom->contains(slot + 3) )
+      continue;
+    uint32_t to = rom->dword(slot);
+    if ( !rom->contains(to) || (to & 1) != 0 )
+      continue;
+    xref_t x = { slot, to, XR_VECTOR };
+    xrefs.push_back(x);
+    add_function(rom, to);
+  }
+  std::lock_guard<std::mutex> g(rom->lock);
+  rom->xrefs.insert(rom->xrefs.end(), xrefs.begin(), xrefs.end());
+}
+
+//--------------------------------------------------------------------------
+// Recursive descent of a function.
+
+inline bool is_branch(int itype)
+{
+  return (itype >= fr_bra && itype <= fr_bhi) || (itype >= fr_fbn && itype <= fr_fbo);
+}
+
+// the general registers written by an instruction, without the feature
+// flags of Instructions[]: the destination operand of the two operand
+// instructions, writeback, the one operand extensions and calls.
+static uint16_t insn_writes(const fr_insn_t &x)
+{
+  uint16_t w = 0;
+  for ( int n = 0; n < FR_MAXOP; n++ )
+  {
+    const fr_op_t &op = x.ops[n];
+    if ( op.type == FR_O_PHRASE && op.reg <= rR15
+      && (op.specflag2 == fIGRP || op.specflag2 == fIGRM) )
+    {
+      w |= 1 << op.reg;
+    }
+  }
+  switch ( x.itype )
+  {
+    case fr_cmp:
+    case fr_cmp2:
+    case fr_btstl:
+    case fr_btsth:
+    case fr_mul:
+    case fr_mulu:
+    case fr_mulh:
+    case fr_muluh:
+      break;
+    case fr_call:
+    case fr_lcall:
+      w |= FR_CALL_SPOILED;
+      break;
+    case fr_extsb:
+    case fr_extub:
+    case fr_extsh:
+    case fr_extuh:
+    case fr_srch0:
+    case fr_srch1:
+    case fr_srchc:
+    case fr_xchb:
+      if ( x.ops[0].type == FR_O_REG && x.ops[0].reg <= rR15 )
+        w |= 1 << x.ops[0].reg;
+      // fallthrough
+    default:
+      if ( x.ops[1].type == FR_O_REG && x.ops[1].reg <= rR15 )
+        w |= 1 << x.ops[1].reg;
+      break;
+    case fr_ldm0:
+      w |= 0x00FF | (1 << rR15);
+      break;
+    case fr_ldm1:
+      w |= 0xFF00;
+      break;
+    case fr_stm0:
+    case fr_stm1:
+    case fr_addsp:
+      w |= 1 << rR15;
+      break;
+    case fr_enter:
+    case fr_leave:
+      w |= (1 << rR14) | (1 << rR15);
+      break;
+  }
+  return w;
+}
+
+// a decoded instruction of the function
+struct code_t
+{
+  fr_insn_t insn;
+  bool flows;                           // execution continues after it
+};
+
+typedef std::map<uint32_t, code_t> code_map_t;
+
+// the instructions executed before the jmp, found by address: the run of
+// code ending at the jmp.
+struct window_t
+{
+  const fr_insn_t *insns[FR_SW_WINDOW];
+  int n;
+
+  window_t(const code_map_t &code, uint32_t jmp);
+  int find_def(int i, uint16_t reg) const;
+  const fr_insn_t *at(int i) const { return i >= 0 && i < n ? insns[i] : NULL; }
+};
+
+window_t::window_t(const code_map_t &code, uint32_t jmp) : n(0)
+{
+  code_map_t::const_iterator p = code.find(jmp);
+  insns[n++] = &p->second.insn;
+  while ( n < FR_SW_WINDOW && p != code.begin() )
+  {
+    uint32_t ea = p->first;
+    --p;
+    if ( p->first + p->second.insn.size != ea || !p->second.flows )
+      break;
+    insns[n++] = &p->second.insn;
+  }
+}
+
+// the first instruction from i on which writes reg, or -1.
+int window_t::find_def(int i, uint16_t reg) const
+{
+  for ( ; i < n; i++ )
+  {
+    if ( insns[i]->itype == fr_call || insns[i]->itype == fr_lcall )
+      return -1;
+    if ( (insn_writes(*insns[i]) & (1 << reg)) != 0 )
+      return i;
+  }
+  return -1;
+}
+
+inline bool is_reg(const fr_op_t &op, int reg)
+{
+  return op.type == FR_O_REG && op.reg == reg;
+}
+
+// ldi #v, reg at i?
+static bool get_ldi(const window_t &w, int i, int reg, uint32_t *v)
+{
+  const fr_insn_t *x = w.at(i);
+  if ( x == NULL || !fr_is_ldi(x->itype) || !is_reg(x->ops[1], reg) )
+    return false;
+  *v = fr_ldi_value(x->itype, x->ops[0].value);
+  return true;
+}
+
+// follow the index back through lsl / add rX, rX and mov from the table
+// load at i. fills the element size and returns the unscaled register
+// and its position, or -1.
+static int match_index(const window_t &w, int i, int reg, int esize, int *pos)
+{
+  int shift = esize == 4 ? 2 : 1;
+  bool scaled = false;
+  for ( int k = 0; k < 4; k++ )
+  {
+    int d = w.find_def(i, uint16_t(reg));
+    const fr_insn_t *x = w.at(d);
+    if ( x == NULL )
+      break;
+    if ( !scaled && x->itype == fr_lsl
+      && x->ops[0].type == FR_O_IMM && int(x->ops[0].value) == shift )
+    {
+      scaled = true;
+    }
+    else if ( !scaled && shift == 1 && x->itype == fr_add
+           && is_reg(x->ops[0], reg) && is_reg(x->ops[1], reg) )
+    {
+      scaled = true;
+    }
+    else if ( x->itype == fr_mov && x->ops[0].type == FR_O_REG && x->ops[0].reg <= rR15 )
+    {
+      reg = x->ops[0].reg;
+    }
+    else
+    {
+      break;
+    }
+    i = d + 1;
+    *pos = d;
+  }
+  return scaled ? reg : -1;
+}
+
+// the guard of the index register: cmp #COUNT / ldi + cmp, and bnc / bhi
+// to the default, optionally after an add / add2 giving the low case.
+static bool match_guard(const window_t &w, int i, int reg, switch_t &sw)
+{
+  for ( ; i < w.n; i++ )
+  {
+    const fr_insn_t &br = *w.insns[i];
+    if ( !is_branch(br.itype) )
+      continue;
+    if ( br.itype != fr_bnc && br.itype != fr_bhi )
+      return false;
+    const fr_insn_t *cmp = w.at(i + 1);
+    if ( cmp == NULL || cmp->itype != fr_cmp || !is_reg(cmp->ops[1], reg) )
+      return false;
+    uint32_t count;
+    if ( cmp->ops[0].type == FR_O_IMM )
+      count = cmp->ops[0].value;
+    else if ( cmp->ops[0].type != FR_O_REG
+           || !get_ldi(w, w.find_def(i + 2, cmp->ops[0].reg), cmp->ops[0].reg, &count) )
+      return false;
+    if ( br.itype == fr_bhi )
+      count++;
+    if ( count == 0 || count > FR_SW_MAXCASES )
+      return false;
+    sw.ncases = count;
+    sw.defjump = br.ops[0].addr;
+
+    const fr_insn_t *add = w.at(w.find_def(i + 2, uint16_t(reg)));
+    if ( add != NULL && add->ops[0].type == FR_O_IMM
+      && (add->itype == fr_add2 || add->itype == fr_add) )
+    {
+      sw.lowcase = uint32_t(-int32_t(add->ops[0].value));
+    }
+    return true;
+  }
+  return false;
+}
+
+// is the jmp @rA at jmp a table jump? reads the table into sw.
+static bool match_switch(const rom_t &rom, const code_map_t &code, uint32_t jmp, switch_t &sw)
+{
+  window_t w(code, jmp);
+  const fr_insn_t &j = *w.insns[0];
+  if ( j.ops[0].type != FR_O_PHRASE || j.ops[0].specflag2 != fIGR )
+    return false;
+  int ra = j.ops[0].reg;
+  sw = switch_t();
+  sw.jmp = jmp;
+
+  // halfword offsets from the table: lduh ... ; add rB, rA
+  int d = w.find_def(1, uint16_t(ra));
+  const fr_insn_t *x = w.at(d);
+  int rel_base = -1;
+  if ( x != NULL && x->itype == fr_add && x->ops[0].type == FR_O_REG && is_reg(x->ops[1], ra) )
+  {
+    rel_base = x->ops[0].reg;
+    d = w.find_def(d + 1, uint16_t(ra));
+    x = w.at(d);
+  }
+  if ( x == NULL || !is_reg(x->ops[1], ra) || x->ops[0].type != FR_O_PHRASE
+    || (x->itype != fr_ld && x->itype != fr_lduh)
+    || (rel_base >= 0) != (x->itype == fr_lduh) )
+  {
+    return false;
+  }
+  sw.esize = x->itype == fr_ld ? 4 : 2;
+
+  // ld @(r13, rB) with r13 the scaled index, or ld @rC with rC = rB + index
+  int base, index, pos = d;
+  if ( x->ops[0].specflag2 == fR13RI )
+  {
+    base = x->ops[0].reg;
+    index = rR13;
+  }
+  else if ( x->ops[0].specflag2 == fIGR )
+  {
+    int a = w.find_def(d + 1, x->ops[0].reg);
+    const fr_insn_t *add = w.at(a);
+    if ( add == NULL || add->itype != fr_add || add->ops[0].type != FR_O_REG
+      || !is_reg(add->ops[1], x->ops[0].reg) )
+    {
+      return false;
+    }
+    base = add->ops[0].reg;
+    index = x->ops[0].reg;
+    pos = a;
+    uint32_t t;
+    if ( !get_ldi(w, w.find_def(a + 1, uint16_t(base)), base, &t) )
+      std::swap(base, index);
+  }
+  else
+  {
+    return false;
+  }
+  if ( !get_ldi(w, w.find_def(pos + 1, uint16_t(base)), base, &sw.table)
+    || (rel_base >= 0 && rel_base != base) )
+  {
+    return false;
+  }
+
+  int ipos = pos;
+  int src = match_index(w, pos + 1, index, sw.esize, &ipos);
+  if ( src < 0 || !match_guard(w, ipos + 1, src, sw) )
+    return false;
+
+  // the table must be in the ROM
+  uint32_t size = sw.ncases * sw.esize;
+  if ( !rom.contains(sw.table) || !rom.contains(sw.table + size - 1) )
+    return false;
+  for ( uint32_t k = 0; k < sw.ncases; k++ )
+  {
+    uint32_t ea = sw.table + k * sw.esize;
+    uint32_t to = sw.esize == 4
+                ? rom.dword(ea)
+                : sw.table + ((rom.bytes[ea - rom.base] << 8) | rom.bytes[ea - rom.base + 1]);
+    if ( !rom.contains(to) || (to & 1) != 0 )
+      return false;
+    sw.targets.push_back(to);
+  }
+  return true;
+}
+
+static void analyze_function(rom_t *rom, uint32_t start)
+{
+  code_map_t code;
+  std::vector<xref_t> xrefs;
+  std::vector<switch_t> switches;
+  std::vector<uint32_t> work(1, start);
+  std::vector<uint32_t> callees;
+
+  while ( !work.empty() && code.size() < MAX_FUNC_INSNS )
+  {
+    uint32_t ea = work.back();
+    work.pop_back();
+
+    // register values set by ldi in this run
+    uint32_t regs[rR15 + 1];
+    uint16_t known = 0;
+
+    while ( code.find(ea) == code.end() )
+    {
+      code_t c;
+      int size = rom->decode(&c.insn, ea);
+      if ( size == 0 )
+        break;
+      const fr_insn_t &x = c.insn;
+      bool delay = (x.auxpref & INSN_DELAY_SHOT) != 0;
+      bool stop = false;
+      uint32_t target = 0;
+      bool has_target = false;
+
+      switch ( x.itype )
+      {
+        case fr_ret:
+        case fr_reti:
+          stop = true;
+          break;
+
+        case fr_call:
+        case fr_lcall:
+          if ( x.ops[0].type == FR_O_NEAR )
+          {
+            target = x.ops[0].addr;
+            has_target = true;
+          }
+          else if ( x.ops[0].type == FR_O_PHRASE && x.ops[0].specflag2 == fIGR
+                 && x.ops[0].reg <= rR15 && (known & (1 << x.ops[0].reg)) != 0 )
+          {
+            target = regs[x.ops[0].reg];
+            has_target = true;
+          }
+          if ( has_target && rom->contains(target) )
+          {
+            xref_t xr = { ea, target, XR_CALL };
+            xrefs.push_back(xr);
+            callees.push_back(target);
+          }
+          break;
+
+        case fr_int:
+          {
+            uint32_t slot = tbr + 0x3FC - 4 * (x.ops[0].value & 0xFF);
+            if ( rom->contains(slot) && rom->contains(slot + 3) )
+            {
+              target = rom->dword(slot);
+              if ( rom->contains(target) )
+              {
+                xref_t xr = { ea, target, XR_CALL };
+                xrefs.push_back(xr);
+                callees.push_back(target);
+              }
+            }
+          }
+          break;
+
+        case fr_jmp:
+          stop = true;
+          break;
+
+        default:
+          if ( is_branch(x.itype) && x.ops[0].type == FR_O_NEAR )
+          {
+            xref_t xr = { ea, x.ops[0].addr, XR_JUMP };
+            xrefs.push_back(xr);
+            work.push_back(x.ops[0].addr);
+            stop = x.itype == fr_bra || x.itype == fr_fba;
+          }
+          break;
+      }
+
+      c.flows = !stop || delay;
+      code[ea] = c;
+
+      if ( x.itype == fr_jmp )
+      {
+        switch_t sw;
+        if ( match_switch(*rom, code, ea, sw) )
+        {
+          for ( size_t k = 0; k < sw.targets.size(); k++ )
+          {
+            xref_t xr = { ea, sw.targets[k], XR_SWITCH };
+            xrefs.push_back(xr);
+            work.push_back(sw.targets[k]);
+          }
+          work.push_back(sw.defjump);
+          switches.push_back(sw);
+        }
+        else if ( x.ops[0].type == FR_O_PHRASE && x.ops[0].reg <= rR15
+               && (known & (1 << x.ops[0].reg)) != 0 )
+        {
+          // tail call through ldi
+          xref_t xr = { ea, regs[x.ops[0].reg], XR_JUMP };
+          xrefs.push_back(xr);
+          callees.push_back(regs[x.ops[0].reg]);
+        }
+      }
+
+      known &= ~insn_writes(x);
+      if ( fr_is_ldi(x.itype) && x.ops[1].type == FR_O_REG && x.ops[1].reg <= rR15 )
+      {
+        regs[x.ops[1].reg] = fr_ldi_value(x.itype, x.ops[0].value);
+        known |= 1 << x.ops[1].reg;
+      }
+
+      ea += size;
+      if ( delay )
+      {
+        // the slot executes with the branch; the flow stops after it
+        code_t s;
+        int ssize = rom->decode(&s.insn, ea);
+        if ( ssize == 0 || code.find(ea) != code.end() )
+          break;
+        s.flows = !stop;
+        code[ea] = s;
+        known &= ~insn_writes(s.insn);
+        ea += ssize;
+      }
+      if ( stop )
+        break;
+    }
+  }
+
+  function_t f = { start, start, uint32_t(code.size()) };
+  if ( !code.empty() )
+  {
+    const code_t &last = code.rbegin()->second;
+    f.end = last.insn.ea + last.insn.size;
+  }
+  for ( size_t k = 0; k < callees.size(); k++ )
+    add_function(rom, callees[k]);
+
+  std::lock_guard<std::mutex> g(rom->lock);
+  rom->funcs.push_back(f);
+  rom->xrefs.insert(rom->xrefs.end(), xrefs.begin(), xrefs.end());
+  rom->switches.insert(rom->switches.end(), switches.begin(), switches.end());
+}
+
+//--------------------------------------------------------------------------
+// Output.
+
+static bool func_less(const function_t &a, const function_t &b)
+{
+  return a.start < b.start;
+}
+
+static bool switch_less(const switch_t &a, const switch_t &b)
+{
+  return a.jmp < b.jmp;
+}
+
+static void write_json(FILE *fp, const rom_t &rom)
+{
+  fprintf(fp, "{\n  \"rom\": \"");
+  for ( size_t i = 0; i < rom.path.size(); i++ )
+  {
+    char c = rom.path[i];
+    if ( c == '"' || c == '\\' )
+      fputc('\\', fp);
+    fputc(c, fp);
+  }
+  fprintf(fp, "\",\n  \"base\": %u,\n  \"size\": %u,\n", rom.base, uint32_t(rom.bytes.size()));
+
+  fprintf(fp, "  \"functions\": [");
+  for ( size_t i = 0; i < rom.funcs.size(); i++ )
+  {
+    const function_t &f = rom.funcs[i];
+    fprintf(fp, "%s\n    {\"start\": %u, \"end\": %u, \"insns\": %u}",
+            i == 0 ? "" : ",", f.start, f.end, f.ninsns);
+  }
+  fprintf(fp, "\n  ],\n  \"xrefs\": [");
+  for ( size_t i = 0; i < rom.xrefs.size(); i++ )
+  {
+    const xref_t &x = rom.xrefs[i];
+    fprintf(fp, "%s\n    {\"from\": %u, \"to\": %u, \"type\": \"%s\"}",
+            i == 0 ? "" : ",", x.from, x.to, xref_names[x.type]);
+  }
+  fprintf(fp, "\n  ],\n  \"switches\": [");
+  for ( size_t i = 0; i < rom.switches.size(); i++ )
+  {
+    const switch_t &s = rom.switches[i];
+    fprintf(fp, "%s\n    {\"jmp\": %u, \"table\": %u, \"esize\": %d, \"lowcase\": %u,"
+                " \"ncases\": %u, \"default\": %u, \"targets\": [",
+            i == 0 ? "" : ",", s.jmp, s.table, s.esize, s.lowcase, s.ncases, s.defjump);
+    for ( size_t k = 0; k < s.targets.size(); k++ )
+      fprintf(fp, "%s%u", k == 0 ? "" : ", ", s.targets[k]);
+    fprintf(fp, "]}");
+  }
+  fprintf(fp, "\n  ]\n}\n");
+}
+
+// one table: kind,ea,a,b,c,d,e
+static void write_csv(FILE *fp, const rom_t &rom)
+{
+  fprintf(fp, "kind,ea,a,b,c,d,e\n");
+  for ( size_t i = 0; i < rom.funcs.size(); i++ )
+  {
+    const function_t &f = rom.funcs[i];
+    fprintf(fp, "function,0x%X,0x%X,%u,,,\n", f.start, f.end, f.ninsns);
+  }
+  for ( size_t i = 0; i < rom.xrefs.size(); i++ )
+  {
+    const xref_t &x = rom.xrefs[i];
+    fprintf(fp, "xref,0x%X,0x%X,%s,,,\n", x.from, x.to, xref_names[x.type]);
+  }
+  for ( size_t i = 0; i < rom.switches.size(); i++ )
+  {
+    const switch_t &s = rom.switches[i];
+    fprintf(fp, "switch,0x%X,0x%X,%d,%u,%u,0x%X\n",
+            s.jmp, s.table, s.esize, s.lowcase, s.ncases, s.defjump);
+  }
+}
+
+static bool write_rom(rom_t *rom, const std::string &dir, bool csv)
+{
+  std::sort(rom->funcs.begin(), rom->funcs.end(), func_less);
+  std::sort(rom->xrefs.begin(), rom->xrefs.end());
+  rom->xrefs.erase(std::unique(rom->xrefs.begin(), rom->xrefs.end(),
+                               [](const xref_t &a, const xref_t &b)
+                               { return !(a < b) && !(b < a); }),
+                   rom->xrefs.end());
+  std::sort(rom->switches.begin(), rom->switches.end(), switch_less);
+
+  std::string name = rom->path;
+  size_t slash = name.find_last_of("/\\");
+  if ( slash != std::string::npos )
+    name = name.substr(slash + 1);
+  std::string out = (dir.empty() ? std::string() : dir + "/") + name + (csv ? ".csv" : ".json");
+  FILE *fp = fopen(out.c_str(), "w");
+  if ( fp == NULL )
+  {
+    fprintf(stderr, "frbatch: can not write %s\n", out.c_str());
+    return false;
+  }
+  if ( csv )
+    write_csv(fp, *rom);
+  else
+    write_json(fp, *rom);
+  fclose(fp);
+  printf("%s: %zu functions, %zu xrefs, %zu switches -> %s\n",
+         rom->path.c_str(), rom->funcs.size(), rom->xrefs.size(),
+         rom->switches.size(), out.c_str());
+  return true;
+}
+
+//--------------------------------------------------------------------------
+static void usage(void)
+{
+  fprintf(stderr,
+          "usage: frbatch [-j threads] [-b base] [-t tbr] [-e entry]... [-f json|csv] [-o dir]\n"
+          "               rom.bin[@base]...\n");
+  exit(1);
+}
+
+static bool load_file(std::vector<uint8_t> &img, const char *fname)
+{
+  FILE *fp = fopen(fname, "rb");
+  if ( fp == NULL )
+    return false;
+  uint8_t buf[65536];
+  size_t n;
+  while ( (n = fread(buf, 1, sizeof(buf), fp)) != 0 )
+    img.insert(img.end(), buf, buf + n);
+  fclose(fp);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int nthreads = int(std::thread::hardware_concurrency());
+  uint32_t base = 0;
+  bool csv = false;
+  std::string dir;
+
+  int i;
+  for ( i = 1; i < argc && argv[i][0] == '-'; i++ )
+  {
+    if ( i + 1 == argc )
+      usage();
+    const char *arg = argv[++i];
+    switch ( argv[i - 1][1] )
+    {
+      case 'j': nthreads = atoi(arg); break;
+      case 'b': base = uint32_t(strtoul(arg, NULL, 0)); break;
+      case 't': tbr = uint32_t(strtoul(arg, NULL, 0)); break;
+      case 'e': entries.push_back(uint32_t(strtoul(arg, NULL, 0))); break;
+      case 'o': dir = arg; break;
+      case 'f':
+        if ( strcmp(arg, "csv") == 0 )
+          csv = true;
+        else if ( strcmp(arg, "json") != 0 )
+          usage();
+        break;
+      default:  usage();
+    }
+  }
+  if ( i == argc )
+    usage();
+  if ( nthreads < 1 )
+    nthreads = 1;
+
+  std::vector<std::unique_ptr<rom_t> > roms;
+  for ( ; i < argc; i++ )
+  {
+    std::unique_ptr<rom_t> rom(new rom_t);
+    std::string arg = argv[i];
+    size_t at = arg.rfind('@');
+    rom->base = base;
+    if ( at != std::string::npos )
+    {
+      rom->base = uint32_t(strtoul(arg.c_str() + at + 1, NULL, 0));
+      arg.resize(at);
+    }
+    rom->path = arg;
+    if ( !load_file(rom->bytes, arg.c_str()) || rom->bytes.size() < 2 )
+    {
+      fprintf(stderr, "frbatch: can not read %s\n", arg.c_str());
+      return 1;
+    }
+    rom->bytes.resize(rom->bytes.size() & ~size_t(1));
+    rom->base &= ~1;
+    rom->sizes.resize(rom->nhw());
+    roms.push_back(std::move(rom));
+  }
+
+  pool_t p(nthreads);
+  pool = &p;
+
+  // classify all the segments, then scan them and follow the code
+  for ( size_t r = 0; r < roms.size(); r++ )
+  {
+    rom_t *rom = roms[r].get();
+    for ( size_t k = 0; k < rom->nhw(); k += CHUNK_HALFWORDS )
+    {
+      size_t n = std::min(size_t(CHUNK_HALFWORDS), rom->nhw() - k);
+      p.submit([rom, k, n] { classify_chunk(rom, k, n); });
+    }
+  }
+  p.wait();
+  for ( size_t r = 0; r < roms.size(); r++ )
+  {
+    rom_t *rom = roms[r].get();
+    import_vectors(rom);
+    for ( size_t k = 0; k < entries.size(); k++ )
+      add_function(rom, entries[k]);
+    for ( size_t k = 0; k < rom->nhw(); k += CHUNK_HALFWORDS )
+    {
+      size_t n = std::min(size_t(CHUNK_HALFWORDS), rom->nhw() - k);
+      p.submit([rom, k, n] { scan_chunk(rom, k, n); });
+    }
+  }
+  p.wait();
+
+  bool ok = true;
+  for ( size_t r = 0; r < roms.size(); r++ )
+    ok &= write_rom(roms[r].get(), dir, csv);
+  return ok ? 0 : 1;
+}
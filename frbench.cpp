@@ -0,0 +1,379 @@
+// Decoder throughput benchmark.
+//
+// Builds synthetic ROM images and decodes them linearly with fr_decode(),
+// the way ana() walks a database: the bytes of each instruction are read
+// through a stub of the IDA byte access functions and handed to the
+// decoder.  Reports instructions per second, ns/insn percentiles, the
+// average cost of each opcode class and the fr_classify() throughput.
+//
+//       make -f frdec.mak frbench
+//       ./obj_frdec/frbench [-s mbytes] [-r runs] [-S seed] [-f rom.bin] [mix...]
+//
+// Mixes: random, fr30, fr65, fr81, dense (default: all of them).
+// -f adds a raw ROM image, decoded from offset 0.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "frdec.hpp"
+
+//--------------------------------------------------------------------------
+// IDA byte access stub: a single loaded area starting at rom_base.
+static const uint8_t *rom;
+static uint32_t rom_base;
+static size_t rom_size;
+
+static bool isLoaded(uint32_t ea)
+{
+  return ea - rom_base < rom_size;
+}
+
+static uint8_t get_byte(uint32_t ea)
+{
+  return isLoaded(ea) ? rom[ea - rom_base] : 0xFF;
+}
+
+static bool get_many_bytes(uint32_t ea, void *buf, size_t size)
+{
+  if ( !isLoaded(ea) || !isLoaded(uint32_t(ea + size - 1)) )
+    return false;
+  memcpy(buf, rom + (ea - rom_base), size);
+  return true;
+}
+
+// decode the instruction at ea, reading it like ana() does.
+static int decode_at(fr_insn_t *insn, uint32_t ea)
+{
+  uint8_t bytes[FR_MAXSIZE];
+  size_t len = FR_MAXSIZE;
+  if ( !get_many_bytes(ea, bytes, sizeof(bytes)) )
+  {
+    for ( len = 0; len < sizeof(bytes) && isLoaded(uint32_t(ea + len)); len++ )
+      bytes[len] = get_byte(uint32_t(ea + len));
+  }
+  return fr_decode(insn, ea, bytes, len);
+}
+
+//--------------------------------------------------------------------------
+static const char *const class_names[FR_IC_LAST] =
+{
+  "common", "ldi:20", "ldi:32", "call", "coproc", "fr81", "invalid"
+};
+
+static int classify(uint32_t ea)
+{
+  return fr_halfword_class((get_byte(ea) << 8) | get_byte(ea + 1));
+}
+
+//--------------------------------------------------------------------------
+// Synthetic images.
+
+// instruction mix: relative weight of each class (FR_IC_INVALID is unused)
+struct mix_t
+{
+  const char *name;
+  int weight[FR_IC_INVALID];
+};
+
+static const mix_t mixes[] =
+{
+  //                common ldi20 ldi32  call coproc fr81
+  { "random",   {     0,    0,    0,    0,    0,    0 } },
+  { "fr30",     {    80,    4,    6,   10,    0,    0 } },
+  { "fr65",     {    76,    4,    6,   10,    4,    0 } },
+  { "fr81",     {    66,    4,    6,   10,    0,   14 } },
+  { "dense",    {     0,    0,   50,   50,    0,    0 } },
+};
+
+// xorshift64*
+static uint64_t rng_state;
+
+static uint32_t rng(void)
+{
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return uint32_t((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void put_word(uint8_t *p, int w)
+{
+  p[0] = uint8_t(w >> 8);
+  p[1] = uint8_t(w);
+}
+
+// pick an encoding of the given class. The operand bits are random;
+// candidates the decoder rejects are drawn again.
+static int make_insn(uint8_t *p, int cls)
+{
+  fr_insn_t insn;
+  for ( ;; )
+  {
+    put_word(p, rng() & 0xFFFF);
+    put_word(p + 2, rng() & 0xFFFF);
+    put_word(p + 4, rng() & 0xFFFF);
+    switch ( cls )
+    {
+      case FR_IC_LDI20:
+        p[0] = 0x9B;
+        break;
+      case FR_IC_LDI32:
+        put_word(p, 0x9F80 | (p[1] & 0x0F));
+        break;
+      case FR_IC_CALL:
+        p[0] = uint8_t(0xD0 | (p[0] & 0x0F));
+        break;
+      case FR_IC_COPROC:
+        put_word(p, 0x9FC0 | (p[1] & 0x3F));
+        break;
+      case FR_IC_FR81:
+        p[0] = (p[0] & 1) ? 0x17 : 0x07;
+        break;
+      default:
+        break;
+    }
+    int size = fr_decode(&insn, 0, p, FR_MAXSIZE);
+    if ( size > 0 && fr_halfword_class((p[0] << 8) | p[1]) == cls )
+      return size;
+  }
+}
+
+static void make_image(std::vector<uint8_t> &img, const mix_t &mix, size_t size)
+{
+  int total = 0;
+  for ( int i = 0; i < FR_IC_INVALID; i++ )
+    total += mix.weight[i];
+
+  // no weights: random bytes
+  img.assign(size, 0);
+  if ( total == 0 )
+  {
+    for ( size_t i = 0; i < size; i++ )
+      img[i] = uint8_t(rng());
+    return;
+  }
+
+  size_t off = 0;
+  while ( off + FR_MAXSIZE <= size )
+  {
+    int pick = int(rng() % total);
+    int cls = 0;
+    while ( pick >= mix.weight[cls] )
+      pick -= mix.weight[cls++];
+    off += make_insn(&img[off], cls);
+  }
+}
+
+//--------------------------------------------------------------------------
+// Measurement.
+
+static uint64_t now_ns(void)
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// decode the whole image once. returns the number of instructions.
+static size_t decode_image(void)
+{
+  fr_insn_t insn;
+  size_t n = 0;
+  uint32_t end = uint32_t(rom_base + rom_size);
+  for ( uint32_t ea = rom_base; ea < end; )
+  {
+    int size = decode_at(&insn, ea);
+    ea += size > 0 ? size : 2;
+    n++;
+  }
+  return n;
+}
+
+// cost of timing an empty interval
+static uint64_t timer_overhead(void)
+{
+  uint64_t best = ~uint64_t(0);
+  for ( int i = 0; i < 1000; i++ )
+  {
+    uint64_t t0 = now_ns();
+    uint64_t t1 = now_ns();
+    best = std::min(best, t1 - t0);
+  }
+  return best;
+}
+
+struct class_stat_t
+{
+  uint64_t count;
+  uint64_t ns;
+};
+
+static uint64_t percentile(const std::vector<uint32_t> &sorted, int pct)
+{
+  if ( sorted.empty() )
+    return 0;
+  return sorted[(sorted.size() - 1) * pct / 100];
+}
+
+static void run(const char *name, int runs)
+{
+  // throughput: whole passes over the image
+  size_t ninsns = 0;
+  uint64_t best = ~uint64_t(0);
+  for ( int r = 0; r < runs; r++ )
+  {
+    uint64_t t0 = now_ns();
+    ninsns = decode_image();
+    best = std::min(best, now_ns() - t0);
+  }
+
+  // halfword classification of the whole image
+  size_t nhw = rom_size / 2;
+  std::vector<uint8_t> classes(nhw);
+  std::vector<uint8_t> sizes(nhw);
+  uint64_t best_cls = ~uint64_t(0);
+  for ( int r = 0; r < runs; r++ )
+  {
+    uint64_t t0 = now_ns();
+    fr_classify(classes.data(), sizes.data(), rom, nhw);
+    best_cls = std::min(best_cls, now_ns() - t0);
+  }
+
+  // latency: every instruction timed on its own
+  uint64_t overhead = timer_overhead();
+  class_stat_t stats[FR_IC_LAST];
+  memset(stats, 0, sizeof(stats));
+  std::vector<uint32_t> samples;
+  samples.reserve(ninsns);
+  fr_insn_t insn;
+  uint32_t end = uint32_t(rom_base + rom_size);
+  for ( uint32_t ea = rom_base; ea < end; )
+  {
+    uint64_t t0 = now_ns();
+    int size = decode_at(&insn, ea);
+    uint64_t t = now_ns() - t0;
+    t = t > overhead ? t - overhead : 0;
+    samples.push_back(uint32_t(std::min(t, uint64_t(0xFFFFFFFF))));
+    int cls = classify(ea);
+    stats[cls].count++;
+    stats[cls].ns += t;
+    ea += size > 0 ? size : 2;
+  }
+  std::sort(samples.begin(), samples.end());
+
+  double secs = best / 1e9;
+  printf("%-8s %8zu insns  %7.2f Minsn/s  %6.2f ns/insn  p50 %3llu  p90 %3llu  p99 %4llu  p99.9 %5llu ns\n",
+         name, ninsns, ninsns / secs / 1e6, double(best) / ninsns,
+         (unsigned long long)percentile(samples, 50),
+         (unsigned long long)percentile(samples, 90),
+         (unsigned long long)percentile(samples, 99),
+         (unsigned long long)samples[(samples.size() - 1) * 999 / 1000]);
+  for ( int i = 0; i < FR_IC_LAST; i++ )
+  {
+    if ( stats[i].count == 0 )
+      continue;
+    printf("         %-8s %5.1f%%  %6.2f ns/insn\n",
+           class_names[i],
+           100.0 * stats[i].count / samples.size(),
+           double(stats[i].ns) / stats[i].count);
+  }
+  printf("         classify %7.2f ns/halfword  %6.2f GB/s\n",
+         double(best_cls) / nhw, rom_size / (best_cls + 1.0));
+}
+
+//--------------------------------------------------------------------------
+static void usage(void)
+{
+  fprintf(stderr,
+          "usage: frbench [-s mbytes] [-r runs] [-S seed] [-f rom.bin] [mix...]\n"
+          "mixes:");
+  for ( size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++ )
+    fprintf(stderr, " %s", mixes[i].name);
+  fprintf(stderr, "\n");
+  exit(1);
+}
+
+static bool load_file(std::vector<uint8_t> &img, const char *fname)
+{
+  FILE *fp = fopen(fname, "rb");
+  if ( fp == NULL )
+    return false;
+  uint8_t buf[65536];
+  size_t n;
+  while ( (n = fread(buf, 1, sizeof(buf), fp)) != 0 )
+    img.insert(img.end(), buf, buf + n);
+  fclose(fp);
+  return true;
+}
+
+static void bench_image(const char *name, const std::vector<uint8_t> &img, int runs)
+{
+  rom = img.data();
+  rom_base = 0;
+  rom_size = img.size() & ~size_t(1);
+  run(name, runs);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t size = 4 << 20;
+  int runs = 5;
+  const char *fname = NULL;
+  rng_state = 0x9E3779B97F4A7C15ULL;
+
+  int i;
+  for ( i = 1; i < argc && argv[i][0] == '-'; i++ )
+  {
+    if ( i + 1 == argc )
+      usage();
+    switch ( argv[i][1] )
+    {
+      case 's': size = size_t(atof(argv[++i]) * (1 << 20)); break;
+      case 'r': runs = atoi(argv[++i]); break;
+      case 'S': rng_state = strtoull(argv[++i], NULL, 0) | 1; break;
+      case 'f': fname = argv[++i]; break;
+      default:  usage();
+    }
+  }
+  if ( size < 16 || runs < 1 )
+    usage();
+
+  std::vector<const mix_t *> todo;
+  for ( ; i < argc; i++ )
+  {
+    size_t m;
+    for ( m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++ )
+      if ( strcmp(argv[i], mixes[m].name) == 0 )
+        break;
+    if ( m == sizeof(mixes) / sizeof(mixes[0]) )
+      usage();
+    todo.push_back(&mixes[m]);
+  }
+  if ( todo.empty() && fname == NULL )
+  {
+    for ( size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++ )
+      todo.push_back(&mixes[m]);
+  }
+
+  std::vector<uint8_t> img;
+  for ( size_t m = 0; m < todo.size(); m++ )
+  {
+    make_image(img, *todo[m], size);
+    bench_image(todo[m]->name, img, runs);
+  }
+  if ( fname != NULL )
+  {
+    img.clear();
+    if ( !load_file(img, fname) || img.size() < 2 )
+    {
+      fprintf(stderr, "frbench: can not read %s\n", fname);
+      return 1;
+    }
+    bench_image("file", img, runs);
+  }
+  return 0;
+}
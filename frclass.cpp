@@ -0,0 +1,312 @@
+// Halfword classification.
+//
+// fr_classify() tags every halfword of a span with the class and size of
+// the instruction that would start there, so the pre-decoder and the code
+// vs data heuristics can look them up instead of going through the
+// decoder's prefix checks one halfword at a time.
+//
+// The result only depends on the halfword.  A 64K table built from the
+// decoder holds it; the SSE2 / AVX2 scans compute the common case with a
+// few compares per vector and only fall back to the table for the high
+// bytes whose low byte matters (0x07, 0x17, 0x97 and the rest of 0x9F).
+
+#include <string.h>
+
+#ifdef __IDP__
+#include <pro.h>
+#endif
+#include "frdec.hpp"
+
+#if !defined(FRDEC_NO_SIMD)                                               \
+ && (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)          \
+  || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FR_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__)
+#define FR_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FR_TARGET_AVX2
+#else
+#define FR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#endif
+
+#define HW_INFO(cls, size)    uint8_t((cls) | ((size) << 4))
+#define HW_CLASS(info)        ((info) & 0xF)
+#define HW_SIZE(info)         ((info) >> 4)
+
+// what the vector scans compute for a halfword; -1 if they leave it to the table.
+static int vector_rule(int hw)
+{
+  int hi = hw >> 8;
+  if ( hi == 0x9B )
+    return HW_INFO(FR_IC_LDI20, 4);
+  if ( (hw & 0xFFF0) == 0x9F80 )
+    return HW_INFO(FR_IC_LDI32, 6);
+  if ( (hw & 0xFFC0) == 0x9FC0 )
+    return HW_INFO(FR_IC_COPROC, 4);
+  if ( (hi & 0xF0) == 0xD0 )
+    return HW_INFO(FR_IC_CALL, 2);
+  if ( hi == 0xBE )
+    return HW_INFO(FR_IC_INVALID, 0);
+  if ( (hi & 0xEF) == 0x07 || hi == 0x97 || hi == 0x9F )
+    return -1;
+  return HW_INFO(FR_IC_COMMON, 2);
+}
+
+struct hw_table_t
+{
+  uint8_t info[0x10000];
+  bool vector_ok;       // vector_rule() agrees with the decoder
+
+  hw_table_t(void) : vector_ok(true)
+  {
+    uint8_t bytes[FR_MAXSIZE];
+    memset(bytes, 0, sizeof(bytes));
+    fr_insn_t insn;
+    for ( int hw = 0; hw < 0x10000; hw++ )
+    {
+      bytes[0] = uint8_t(hw >> 8);
+      bytes[1] = uint8_t(hw);
+      int size = fr_decode(&insn, 0, bytes, sizeof(bytes));
+      int cls = size <= 0                 ? FR_IC_INVALID
+              : (hw & 0xFF00) == 0x9B00   ? FR_IC_LDI20
+              : (hw & 0xFFF0) == 0x9F80   ? FR_IC_LDI32
+              : (hw & 0xF000) == 0xD000   ? FR_IC_CALL
+              : (hw & 0xFFC0) == 0x9FC0   ? FR_IC_COPROC
+              : (hw & 0xEF00) == 0x0700   ? FR_IC_FR81
+              :                             FR_IC_COMMON;
+      info[hw] = HW_INFO(cls, size > 0 ? size : 0);
+      int rule = vector_rule(hw);
+      if ( rule != -1 && rule != info[hw] )
+        vector_ok = false;
+    }
+  }
+};
+
+static const hw_table_t &hw_table(void)
+{
+  static const hw_table_t table;
+  return table;
+}
+
+int fr_halfword_class(int hw)
+{
+  return HW_CLASS(hw_table().info[hw & 0xFFFF]);
+}
+
+int fr_halfword_size(int hw)
+{
+  return HW_SIZE(hw_table().info[hw & 0xFFFF]);
+}
+
+//--------------------------------------------------------------------------
+static void classify_scalar(
+        const hw_table_t &t,
+        uint8_t *classes,
+        uint8_t *sizes,
+        const uint8_t *bytes,
+        size_t n)
+{
+  for ( size_t i = 0; i < n; i++ )
+  {
+    uint8_t info = t.info[(bytes[2 * i] << 8) | bytes[2 * i + 1]];
+    if ( classes != NULL )
+      classes[i] = HW_CLASS(info);
+    if ( sizes != NULL )
+      sizes[i] = HW_SIZE(info);
+  }
+}
+
+#ifdef FR_SSE2
+// index of the lowest set bit of a nonzero mask
+inline int lowest_bit(uint32_t mask)
+{
+#ifdef _MSC_VER
+  unsigned long idx;
+  _BitScanForward(&idx, mask);
+  return int(idx);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+
+// fill the lanes left to the table. bit i of 'mask' stands for halfword i.
+static void fixup_lanes(
+        const hw_table_t &t,
+        uint8_t *classes,
+        uint8_t *sizes,
+        const uint8_t *bytes,
+        uint32_t mask)
+{
+  for ( ; mask != 0; mask &= mask - 1 )
+  {
+    int i = lowest_bit(mask);
+    uint8_t info = t.info[(bytes[2 * i] << 8) | bytes[2 * i + 1]];
+    classes[i] = HW_CLASS(info);
+    sizes[i] = HW_SIZE(info);
+  }
+}
+#endif
+
+#ifdef FR_SSE2
+#define _mm_and         _mm_and_si128
+#define _mm_andnot      _mm_andnot_si128
+#define _mm_or          _mm_or_si128
+#define _mm_srli16      _mm_srli_epi16
+
+// Class, size and table fallback mask of the halfwords whose high and low
+// bytes are in hi and lo, one halfword per byte lane.
+#define SIMD_LANES(T, P, hi, lo, cls, size, irr)                              \
+  do                                                                          \
+  {                                                                           \
+    T ldi20 = P##_cmpeq_epi8(hi, P##_set1_epi8(char(0x9B)));                  \
+    T is9f = P##_cmpeq_epi8(hi, P##_set1_epi8(char(0x9F)));                   \
+    T ldi32 = P##_and(is9f, P##_cmpeq_epi8(P##_and(lo, P##_set1_epi8(char(0xF0))), \
+                                           P##_set1_epi8(char(0x80))));       \
+    T cop = P##_and(is9f, P##_cmpeq_epi8(P##_and(lo, P##_set1_epi8(char(0xC0))), \
+                                         P##_set1_epi8(char(0xC0))));         \
+    T call = P##_cmpeq_epi8(P##_and(hi, P##_set1_epi8(char(0xF0))),           \
+                            P##_set1_epi8(char(0xD0)));                       \
+    T inv = P##_cmpeq_epi8(hi, P##_set1_epi8(char(0xBE)));                    \
+    T wide = P##_or(ldi32, cop);                                              \
+    irr = P##_or(P##_andnot(wide, is9f),                                      \
+                 P##_or(P##_cmpeq_epi8(hi, P##_set1_epi8(char(0x97))),        \
+                        P##_cmpeq_epi8(P##_and(hi, P##_set1_epi8(char(0xEF))), \
+                                       P##_set1_epi8(0x07))));                \
+    cls = P##_or(P##_or(P##_and(ldi20, P##_set1_epi8(FR_IC_LDI20)),           \
+                        P##_and(ldi32, P##_set1_epi8(FR_IC_LDI32))),          \
+                 P##_or(P##_or(P##_and(call, P##_set1_epi8(FR_IC_CALL)),      \
+                               P##_and(cop, P##_set1_epi8(FR_IC_COPROC))),    \
+                        P##_and(inv, P##_set1_epi8(FR_IC_INVALID))));         \
+    wide = P##_or(wide, ldi20);                                               \
+    size = P##_or(P##_andnot(P##_or(P##_or(inv, ldi20), cop),                 \
+                             P##_set1_epi8(2)),                               \
+                  P##_and(wide, P##_set1_epi8(4)));                           \
+  } while ( 0 )
+
+// split 2 vectors of big endian halfwords into their high and low bytes.
+// The halfwords end up in order for SSE2; AVX2 packs within 128 bit halves.
+#define SIMD_SPLIT(P, x0, x1, hi, lo)                                         \
+  do                                                                          \
+  {                                                                           \
+    hi = P##_packus_epi16(P##_and(x0, P##_set1_epi16(0x00FF)),                \
+                          P##_and(x1, P##_set1_epi16(0x00FF)));               \
+    lo = P##_packus_epi16(P##_srli16(x0, 8), P##_srli16(x1, 8));              \
+  } while ( 0 )
+
+// returns the number of halfwords done.
+static size_t classify_sse2(
+        const hw_table_t &t,
+        uint8_t *classes,
+        uint8_t *sizes,
+        const uint8_t *bytes,
+        size_t n)
+{
+  uint8_t cbuf[16];
+  uint8_t sbuf[16];
+  size_t i;
+  for ( i = 0; i + 16 <= n; i += 16 )
+  {
+    __m128i x0 = _mm_loadu_si128((const __m128i *)(bytes + 2 * i));
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(bytes + 2 * i + 16));
+    __m128i hi, lo, cls, size, irr;
+    SIMD_SPLIT(_mm, x0, x1, hi, lo);
+    SIMD_LANES(__m128i, _mm, hi, lo, cls, size, irr);
+    uint8_t *cdst = classes != NULL ? classes + i : cbuf;
+    uint8_t *sdst = sizes != NULL ? sizes + i : sbuf;
+    _mm_storeu_si128((__m128i *)cdst, cls);
+    _mm_storeu_si128((__m128i *)sdst, size);
+    uint32_t mask = _mm_movemask_epi8(irr);
+    if ( mask != 0 )
+      fixup_lanes(t, cdst, sdst, bytes + 2 * i, mask);
+  }
+  return i;
+}
+#endif
+
+#ifdef FR_AVX2
+#define _mm256_and      _mm256_and_si256
+#define _mm256_andnot   _mm256_andnot_si256
+#define _mm256_or       _mm256_or_si256
+#define _mm256_srli16   _mm256_srli_epi16
+
+FR_TARGET_AVX2 static size_t classify_avx2(
+        const hw_table_t &t,
+        uint8_t *classes,
+        uint8_t *sizes,
+        const uint8_t *bytes,
+        size_t n)
+{
+  uint8_t cbuf[32];
+  uint8_t sbuf[32];
+  size_t i;
+  for ( i = 0; i + 32 <= n; i += 32 )
+  {
+    __m256i x0 = _mm256_loadu_si256((const __m256i *)(bytes + 2 * i));
+    __m256i x1 = _mm256_loadu_si256((const __m256i *)(bytes + 2 * i + 32));
+    __m256i hi, lo, cls, size, irr;
+    SIMD_SPLIT(_mm256, x0, x1, hi, lo);
+    // put the quadwords back in order
+    hi = _mm256_permute4x64_epi64(hi, 0xD8);
+    lo = _mm256_permute4x64_epi64(lo, 0xD8);
+    SIMD_LANES(__m256i, _mm256, hi, lo, cls, size, irr);
+    uint8_t *cdst = classes != NULL ? classes + i : cbuf;
+    uint8_t *sdst = sizes != NULL ? sizes + i : sbuf;
+    _mm256_storeu_si256((__m256i *)cdst, cls);
+    _mm256_storeu_si256((__m256i *)sdst, size);
+    uint32_t mask = _mm256_movemask_epi8(irr);
+    if ( mask != 0 )
+      fixup_lanes(t, cdst, sdst, bytes + 2 * i, mask);
+  }
+  return i;
+}
+
+static bool have_avx2(void)
+{
+#ifdef _MSC_VER
+  int regs[4];
+  __cpuid(regs, 0);
+  if ( regs[0] < 7 )
+    return false;
+  __cpuid(regs, 1);
+  const int osxsave_avx = (1 << 27) | (1 << 28);
+  if ( (regs[2] & osxsave_avx) != osxsave_avx || (_xgetbv(0) & 6) != 6 )
+    return false;
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+//--------------------------------------------------------------------------
+void fr_classify(uint8_t *classes, uint8_t *sizes, const uint8_t *bytes, size_t n)
+{
+  const hw_table_t &t = hw_table();
+  size_t done = 0;
+  if ( t.vector_ok )
+  {
+#ifdef FR_AVX2
+    static const bool avx2 = have_avx2();
+    if ( avx2 )
+      done = classify_avx2(t, classes, sizes, bytes, n);
+#endif
+#ifdef FR_SSE2
+    done += classify_sse2(t,
+                          classes != NULL ? classes + done : NULL,
+                          sizes != NULL ? sizes + done : NULL,
+                          bytes + 2 * done,
+                          n - done);
+#endif
+  }
+  classify_scalar(t,
+                  classes != NULL ? classes + done : NULL,
+                  sizes != NULL ? sizes + done : NULL,
+                  bytes + 2 * done,
+                  n - done);
+}
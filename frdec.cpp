@@ -0,0 +1,1448 @@
+// Fujitsu FR instruction decoder.
+//
+// This is the decode core of the processor module.  It does not use the
+// IDA kernel: it decodes a span of bytes at a given address into an
+// fr_insn_t.  ana.cpp wraps it for IDA and frdec.mak builds it on its own.
+
+#include <string.h>
+
+#ifdef __IDP__
+#include <pro.h>
+#include "frdec.hpp"
+#else
+#include "frdec.hpp"
+#include <assert.h>
+#define QASSERT(code, cond)   assert(cond)
+#define INTERR(code)          assert(!"internal error")
+#define qnumber(array)        int(sizeof(array) / sizeof((array)[0]))
+#endif
+
+// decoder state for one instruction.
+struct fr_ctx_t
+{
+  fr_insn_t &insn;
+  const uint8_t *bytes;   // bytes at insn.ea
+  size_t len;
+  bool short_read;        // an operand lies past the end of bytes
+};
+
+static uint8_t fetch_byte(fr_ctx_t &c, size_t off)
+{
+  if ( off >= c.len )
+  {
+    c.short_read = true;
+    return 0xFF;
+  }
+  return c.bytes[off];
+}
+
+static uint16_t fetch_word(fr_ctx_t &c, size_t off)
+{
+  return uint16_t((fetch_byte(c, off) << 8) | fetch_byte(c, off + 1));
+}
+
+static uint8_t next_byte(fr_ctx_t &c)
+{
+  return fetch_byte(c, c.insn.size++);
+}
+
+static uint16_t next_word(fr_ctx_t &c)
+{
+  uint16_t w = fetch_word(c, c.insn.size);
+  c.insn.size += 2;
+  return w;
+}
+
+static uint32_t next_long(fr_ctx_t &c)
+{
+  uint32_t hi = next_word(c);
+  return (hi << 16) | next_word(c);
+}
+
+// distinct sizes :
+//lint -esym(749, S_11) not referenced
+enum
+{
+    S_0,
+    S_4,        // 4 bits
+    S_5,        // 5 bits
+    S_8,        // 8 bits
+    S_11,       // 11 bits
+    S_12,       // 12 bits
+    S_16        // 16 bits
+};
+
+// bits numbers for sizes :
+constexpr int bits[] =
+{
+  0,
+  4,
+  5,
+  8,
+  11,
+  12,
+  16
+};
+
+// masks for sizes :
+const int masks[] =
+{
+  0x0000,
+  0x000F,
+  0x001F,
+  0x00FF,
+  0x07FF,
+  0x0FFF,
+  0xFFFF
+};
+
+const char dtypes[] =
+{
+  0,
+  FR_DT_BYTE,
+  FR_DT_BYTE,
+  FR_DT_BYTE,
+  FR_DT_WORD,
+  FR_DT_WORD,
+  FR_DT_WORD
+};
+
+// distinct operands :
+enum
+{
+    O_null,         // null opcode
+    O_gr,           // general register                         Ri
+    O_gri,          // general register indirect                @Ri
+    O_grip,         // general register indirect post-increment @Ri+
+    O_r13_gr_i,     // indirect r13 + general register          @(R13, Ri)
+    O_r14_imm8_i,   // indirect r14 + 8 bits immediate value    @(R14, imm)
+    O_r15_imm4_i,   // indirect r15 + 4 bits immediate value    @(R15, imm)
+    O_r15ip,        // indirect r15 post-increment              @R15+
+    O_r15im,        // indirect r15 pre-decrement               @-R15
+    O_r13,          // register r13                             R13
+    O_r13ip,        // indirect r13 post-increment              @R13+
+    O_dr,           // dedicated register                       Rs
+    O_ps,           // program status register (PS)             PS
+    O_imm,          // immediate value                          #i
+    O_diri,         // indirect direct value                    @i
+    O_rel,          // relative value                           label5
+    O_reglist,      // register list                            (R0, R1, R2, ...)
+    O_ccr,          // Condition code register / part of        PS,
+    O_tbr,          // The TBR
+};
+
+static int invert_word(int word) {
+    int new_word = 0;
+
+    new_word |= (word & 0x000F) >> 0;
+    new_word <<= 4;
+    new_word |= (word & 0x00F0) >> 4;
+    new_word <<= 4;
+    new_word |= (word & 0x0F00) >> 8;
+    new_word <<= 4;
+    new_word |= (word & 0xF000) >> 12;
+
+    return new_word;
+}
+
+// structure of an opcode :
+struct opcode_t
+{
+  int insn;
+  int opcode;
+  int opcode_size;
+
+  int op1;
+  int op1_size;
+  int op2;
+  int op2_size;
+
+  /// op3 is an implicit op and not displayed.  
+  /// It is used for instructions which directly read the PS register 
+  /// (and could be used for default base index registers that won't
+  /// fit in a normal description). 
+  int op3;
+
+#define I_SWAPOPS          0x00000100      // swap operands
+#define I_DSHOT            0x00000200      // delay shot
+#define I_ADDR_R           OP_ADDR_R
+#define I_ADDR_W           OP_ADDR_W
+#define I_IMM_2            0x00001000      // imm = imm * 2
+#define I_IMM_4            0x00002000      // imm = imm * 4
+#define I_IMM_16           0x00004000      // imm = imm + 16
+#define I_MEM_8            0x00010000      // load/store 8 bytes to/from memptr
+#define I_MEM_16           0x00020000      // load/store 16 bytes to/from memptr
+#define I_MEM_32           0x00040000      // load/store 32 bytes to/from memptr
+#define I_BAD_DELAY        0x00100000      // instruction that cannot be in delay slot
+
+  int flags;
+
+  inline bool swap_ops(void) const { return (flags & I_SWAPOPS) != 0; }
+  inline bool delay_shot(void) const { return (flags & I_DSHOT) != 0; }
+  constexpr bool bad_delay(void) const { return (flags & I_BAD_DELAY) != 0; }
+  inline bool implied(void) const { return op1 == O_null && op2 == O_null; }
+
+  constexpr int size(void) const
+  {
+    int n = bits[opcode_size];
+    if ( op1 != O_null )   n += bits[op1_size];
+    if ( op2 != O_null )   n += bits[op2_size];
+    return n;
+  }
+
+  static const struct opcode_t * find(fr_ctx_t &c, int *_data);
+};
+
+// FR opcodes :
+static constexpr struct opcode_t opcodes[] =
+{
+  { fr_add,       0xA6,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_add,       0xA4,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_add2,      0xA5,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_addc,      0xA7,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_ps,      0         },
+  { fr_addn,      0xA2,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_addn,      0xA0,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_addn2,     0xA1,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_sub,       0xAC,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_subc,      0xAD,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_ps,      0         },
+  { fr_subn,      0xAE,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_cmp,       0xAA,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_cmp,       0xA8,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_cmp2,      0xA9,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_and,       0x82,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_and,       0x84,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_andh,      0x85,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_andb,      0x86,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_or,        0x92,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_or,        0x94,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_orh,       0x95,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_orb,       0x96,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_eor,       0x9A,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_eor,       0x9C,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_eorh,      0x9D,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_eorb,      0x9E,       S_8,    O_gr,           S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_bandl,     0x80,       S_8,    O_imm,          S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_bandh,     0x81,       S_8,    O_imm,          S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_borl,      0x90,       S_8,    O_imm,          S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_borh,      0x91,       S_8,    O_imm,          S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_beorl,     0x98,       S_8,    O_imm,          S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_beorh,     0x99,       S_8,    O_imm,          S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_btstl,     0x88,       S_8,    O_imm,          S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_btsth,     0x89,       S_8,    O_imm,          S_4,    O_gri,      S_4,    O_null,    I_BAD_DELAY },
+  { fr_mul,       0xAF,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    I_BAD_DELAY },
+  { fr_mulu,      0xAB,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    I_BAD_DELAY },
+  { fr_mulh,      0xBF,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    I_BAD_DELAY },
+  { fr_muluh,     0xBB,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    I_BAD_DELAY },
+  { fr_div0s,     0x974,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    0 },
+  { fr_div0u,     0x975,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    0 },
+  { fr_div1,      0x976,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    0 },
+  { fr_div2,      0x977,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    0 },
+  { fr_div3,      0x9F60,     S_16,   O_null,         0,      O_null,     0,      O_null,    0         },
+  { fr_div4s,     0x9F70,     S_16,   O_null,         0,      O_null,     0,      O_null,    0         },
+  { fr_lsl,       0xB6,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_lsl,       0xB4,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_lsl2,      0xB5,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    I_IMM_16  },
+  { fr_lsr,       0xB2,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_lsr,       0xB0,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_lsr2,      0xB1,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    I_IMM_16  },
+  { fr_asr,       0xBA,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_asr,       0xB8,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_asr2,      0xB9,       S_8,    O_imm,          S_4,    O_gr,       S_4,    O_null,    I_IMM_16  },
+  // fr_ldi_32 not here (considered as special)                                   O_null,   
+  // fr_ldi_20 not here (considered as special)                                   O_null,   
+  { fr_ldi_8,     0x0C,       S_4,    O_imm,          S_8,    O_gr,       S_4,    O_null,    0         },
+  { fr_ld,        0x04,       S_8,    O_gri,          S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_ld,        0x00,       S_8,    O_r13_gr_i,     S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_ld,        0x02,       S_4,    O_r14_imm8_i,   S_8,    O_gr,       S_4,    O_null,    I_IMM_4   },
+  { fr_ld,        0x03,       S_8,    O_r15_imm4_i,   S_4,    O_gr,       S_4,    O_null,    I_IMM_4   },
+  { fr_ld,        0x70,       S_12,   O_r15ip,        S_0,    O_gr,       S_4,    O_null,    0         },
+  { fr_ld,        0x78,       S_12,   O_r15ip,        S_0,    O_dr,       S_4,    O_null,    0         },
+  { fr_ld,        0x790,      S_16,   O_r15ip,        S_0,    O_ps,       S_0,    O_null,    I_BAD_DELAY },
+  { fr_lduh,      0x05,       S_8,    O_gri,          S_4,    O_gr,       S_4,    O_null,    I_MEM_16  },
+  { fr_lduh,      0x01,       S_8,    O_r13_gr_i,     S_4,    O_gr,       S_4,    O_null,    I_MEM_16  },
+  { fr_lduh,      0x04,       S_4,    O_r14_imm8_i,   S_8,    O_gr,       S_4,    O_null,    I_MEM_16|I_IMM_2   },
+  { fr_ldub,      0x06,       S_8,    O_gri,          S_4,    O_gr,       S_4,    O_null,    I_MEM_8   },
+  { fr_ldub,      0x02,       S_8,    O_r13_gr_i,     S_4,    O_gr,       S_4,    O_null,    I_MEM_8   },
+  { fr_ldub,      0x06,       S_4,    O_r14_imm8_i,   S_8,    O_gr,       S_4,    O_null,    I_MEM_8   },
+  // Begin FR80 / 81
+  { fr_srch0,     0x97C,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    0         },
+  { fr_srch1,     0x97D,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    0         },
+  { fr_srchc,     0x97E,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    0         },
+  // End FR80 / 81
+  { fr_st,        0x14,       S_8,    O_gri,          S_4,    O_gr,       S_4,    O_null,    I_SWAPOPS },
+  { fr_st,        0x10,       S_8,    O_r13_gr_i,     S_4,    O_gr,       S_4,    O_null,    I_SWAPOPS },
+  { fr_st,        0x03,       S_4,    O_r14_imm8_i,   S_8,    O_gr,       S_4,    O_null,    I_SWAPOPS|I_IMM_4 },
+  { fr_st,        0x13,       S_8,    O_r15_imm4_i,   S_4,    O_gr,       S_4,    O_null,    I_SWAPOPS|I_IMM_4 },
+  { fr_st,        0x170,      S_12,   O_gr,           S_4,    O_r15im,    S_0,    O_null,    0         },
+  { fr_st,        0x178,      S_12,   O_dr,           S_4,    O_r15im,    S_0,    O_null,    0         },
+  { fr_st,        0x1790,     S_16,   O_ps,           S_0,    O_r15im,    S_0,    O_null,    0         },
+  { fr_sth,       0x15,       S_8,    O_gri,          S_4,    O_gr,       S_4,    O_null,    I_MEM_16|I_SWAPOPS },
+  { fr_sth,       0x11,       S_8,    O_r13_gr_i,     S_4,    O_gr,       S_4,    O_null,    I_MEM_16|I_SWAPOPS },
+  { fr_sth,       0x05,       S_4,    O_r14_imm8_i,   S_8,    O_gr,       S_4,    O_null,    I_MEM_16|I_SWAPOPS|I_IMM_2 },
+  { fr_stb,       0x16,       S_8,    O_gri,          S_4,    O_gr,       S_4,    O_null,    I_MEM_8|I_SWAPOPS },
+  { fr_stb,       0x12,       S_8,    O_r13_gr_i,     S_4,    O_gr,       S_4,    O_null,    I_MEM_8|I_SWAPOPS },
+  { fr_stb,       0x07,       S_4,    O_r14_imm8_i,   S_8,    O_gr,       S_4,    O_null,    I_MEM_8|I_SWAPOPS },
+  { fr_mov,       0x8B,       S_8,    O_gr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_mov,       0xB7,       S_8,    O_dr,           S_4,    O_gr,       S_4,    O_null,    0         },
+  { fr_mov,       0x171,      S_12,   O_ps,           S_0,    O_gr,       S_4,    O_null,    0         },
+  { fr_mov,       0xB3,       S_8,    O_dr,           S_4,    O_gr,       S_4,    O_null,    I_SWAPOPS },
+  { fr_mov,       0x71,       S_12,   O_gr,           S_4,    O_ps,       S_0,    O_null,    0         },
+  { fr_jmp,       0x970,      S_12,   O_gri,          S_4,    O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_call,      0x971,      S_12,   O_gri,          S_4,    O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_ret,       0x9720,     S_16,   O_null,         0,      O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_int,       0x1F,       S_8,    O_imm,          S_8,    O_imm,      S_0,    O_tbr,     I_BAD_DELAY },
+  { fr_inte,      0x9F30,     S_16,   O_null,         0,      O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_reti,      0x9730,     S_16,   O_null,         0,      O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_bra,       0xE0,       S_8,    O_rel,          S_8,    O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_bno,       0xE1,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_beq,       0xE2,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bne,       0xE3,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bc,        0xE4,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bnc,       0xE5,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bn,        0xE6,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bp,        0xE7,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bv,        0xE8,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bnv,       0xE9,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_blt,       0xEA,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bge,       0xEB,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_ble,       0xEC,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bgt,       0xED,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bls,       0xEE,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_bhi,       0xEF,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_BAD_DELAY },
+  { fr_jmp,       0x9F0,      S_12,   O_gri,          S_4,    O_null,     0,      O_null,    I_DSHOT | I_BAD_DELAY   },
+  { fr_call,      0x9F1,      S_12,   O_gri,          S_4,    O_null,     0,      O_null,    I_DSHOT | I_BAD_DELAY   },
+  { fr_ret,       0x9F20,     S_16,   O_null,         0,      O_null,     0,      O_null,    I_DSHOT | I_BAD_DELAY   },
+  { fr_bra,       0xF0,       S_8,    O_rel,          S_8,    O_null,     0,      O_null,    I_DSHOT | I_BAD_DELAY   },
+  { fr_bno,       0xF1,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_beq,       0xF2,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bne,       0xF3,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bc,        0xF4,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bnc,       0xF5,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bn,        0xF6,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bp,        0xF7,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bv,        0xF8,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bnv,       0xF9,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_blt,       0xFA,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bge,       0xFB,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_ble,       0xFC,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bgt,       0xFD,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bls,       0xFE,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_bhi,       0xFF,       S_8,    O_rel,          S_8,    O_null,     0,      O_ps,      I_DSHOT | I_BAD_DELAY   },
+  { fr_dmov,      0x08,       S_8,    O_diri,         S_8,    O_r13,      S_0,    O_null,    I_ADDR_R  },
+  { fr_dmov,      0x18,       S_8,    O_r13,          S_0,    O_diri,     S_8,    O_null,    I_ADDR_W  },
+  { fr_dmov,      0x0C,       S_8,    O_diri,         S_8,    O_r13ip,    S_0,    O_null,    I_ADDR_R | I_BAD_DELAY },
+  { fr_dmov,      0x1C,       S_8,    O_r13ip,        S_0,    O_diri,     S_8,    O_null,    I_ADDR_W | I_BAD_DELAY },
+  { fr_dmov,      0x0B,       S_8,    O_diri,         S_8,    O_r15im,    S_0,    O_null,    I_ADDR_R | I_BAD_DELAY },
+  { fr_dmov,      0x1B,       S_8,    O_r15ip,        S_0,    O_diri,     S_8,    O_null,    I_ADDR_W | I_BAD_DELAY },
+  { fr_dmovh,     0x09,       S_8,    O_diri,         S_8,    O_r13,      S_0,    O_null,    I_ADDR_R  },
+  { fr_dmovh,     0x19,       S_8,    O_r13,          S_0,    O_diri,     S_8,    O_null,    I_ADDR_W  },
+  { fr_dmovh,     0x0D,       S_8,    O_diri,         S_8,    O_r13ip,    S_0,    O_null,    I_ADDR_R | I_BAD_DELAY },
+  { fr_dmovh,     0x1D,       S_8,    O_r13ip,        S_0,    O_diri,     S_8,    O_null,    I_ADDR_W | I_BAD_DELAY },
+  { fr_dmovb,     0x0A,       S_8,    O_diri,         S_8,    O_r13,      S_0,    O_null,    I_ADDR_R  },
+  { fr_dmovb,     0x1A,       S_8,    O_r13,          S_0,    O_diri,     S_8,    O_null,    I_ADDR_W  },
+  { fr_dmovb,     0x0E,       S_8,    O_diri,         S_8,    O_r13ip,    S_0,    O_null,    I_ADDR_R | I_BAD_DELAY },
+  { fr_dmovb,     0x1E,       S_8,    O_r13ip,        S_0,    O_diri,     S_8,    O_null,    I_ADDR_W | I_BAD_DELAY },
+  { fr_ldres,     0xBC,       S_8,    O_imm,          S_4,    O_grip,     S_4,    O_null,    I_SWAPOPS },
+  { fr_stres,     0xBD,       S_8,    O_imm,          S_4,    O_grip,     S_4,    O_null,    0         },
+  // fr_copop not here (considered as special)                                    O_null,   
+  // fr_copld not here (considered as special)                                    O_null,   
+  // fr_copst not here (considered as special)                                    O_null,   
+  // fr_copsv not here (considered as special)                                    O_null,   
+  { fr_nop,       0x9FA0,     S_16,   O_null,         0,      O_null,     0,      O_null,    0         },
+  { fr_andccr,    0x83,       S_8,    O_imm,          S_8,    O_null,     0,      O_null,    0         },
+  { fr_orccr,     0x93,       S_8,    O_imm,          S_8,    O_null,     0,      O_null,    0         },
+  { fr_stilm,     0x87,       S_8,    O_imm,          S_8,    O_null,     0,      O_null,    0         },
+  { fr_addsp,     0xA3,       S_8,    O_imm,          S_8,    O_null,     0,      O_null,    0         },
+  { fr_extsb,     0x978,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    0         },
+  { fr_extub,     0x979,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    I_MEM_8   },
+  { fr_extsh,     0x97A,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    I_MEM_16  },
+  { fr_extuh,     0x97B,      S_12,   O_gr,           S_4,    O_null,     0,      O_null,    I_MEM_16  },
+  { fr_ldm0,      0x8C,       S_8,    O_reglist,      S_8,    O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_ldm1,      0x8D,       S_8,    O_reglist,      S_8,    O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_stm0,      0x8E,       S_8,    O_reglist,      S_8,    O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_stm1,      0x8F,       S_8,    O_reglist,      S_8,    O_null,     0,      O_null,    I_BAD_DELAY },
+  { fr_enter,     0x0F,       S_8,    O_imm,          S_8,    O_null,     0,      O_null,    I_BAD_DELAY /*I_IMM_4 handled elsewhere*/  },
+  { fr_leave,     0x9F90,     S_16,   O_null,         0,      O_null,     0,      O_null,    0         },
+  { fr_xchb,      0x8A,       S_8,    O_gri,          S_4,    O_gr,       S_4,    O_null,    I_BAD_DELAY },
+  // FR81+ new instructions aren't handled here (especially the float variants) because
+  // they use rather weird register / immediate layouts.  They live in fr81_opcodes[] below.
+};
+
+// number of low bits of the first halfword left out of the opcode compare.
+static constexpr int opcode_shift(int opcode_size)
+{
+  return opcode_size == S_4  ? 12
+       : opcode_size == S_8  ? 8
+       : opcode_size == S_12 ? 4
+       : 0;
+}
+
+// every row must describe a 16 or 32 bit instruction whose opcode sits
+// on a nibble boundary.
+static constexpr bool opcodes_are_valid(void)
+{
+  for ( int i = 0; i < qnumber(opcodes); i++ )
+  {
+    const opcode_t &op = opcodes[i];
+    int n = op.size();
+    if ( n != 16 && n != 32 )
+      return false;
+    if ( op.opcode_size != S_4 && op.opcode_size != S_8
+      && op.opcode_size != S_12 && op.opcode_size != S_16 )
+    {
+      return false;
+    }
+    if ( (op.opcode << opcode_shift(op.opcode_size)) > 0xFFFF )
+      return false;
+  }
+  return true;
+}
+static_assert(opcodes_are_valid(), "malformed row in opcodes[]");
+
+// check if a halfword starts one of the instructions decoded by ana_special()
+// (ldi:20, ldi:32, call(:D) rel, coprocessor and FR81 extensions).
+// Only the top 12 bits are looked at.
+static constexpr bool special_halfword(int data)
+{
+  return (data & 0xFF00) == 0x9B00
+      || (data & 0xFFF0) == 0x9F80
+      || (data & 0xF000) == 0xD000
+      || (data & 0xFFC0) == 0x9FC0
+      || (data & 0xFF00) == 0x0700
+      || (data & 0xFF00) == 0x1700;
+}
+
+// Decode dispatch, indexed by the first halfword of an instruction.
+//
+// hi[] is indexed by the high byte and holds the index of the first
+// opcodes[] row matching it, a sentinel, or OPC_GROUP + n when the high
+// byte also carries 12/16 bit opcodes; lo[n][] then resolves the next
+// nibble. 16 bit opcodes all end in a zero nibble, which find() checks.
+// The tables are generated from opcodes[] at compile time: rows are
+// walked in table order and a slot is only taken by the first row that
+// matches it, which keeps the semantics of the old linear scan.
+#define OPC_GROUP     0xF0      // + index into lo[]
+#define OPC_SPECIAL   0xFE      // handled by ana_special()
+#define OPC_NONE      0xFF      // not a valid instruction
+#define OPC_MAXGROUPS (OPC_SPECIAL - OPC_GROUP)
+static_assert(qnumber(opcodes) <= OPC_GROUP, "opcodes[] is too large for the dispatch tables");
+
+struct opcode_dispatch_t
+{
+  uint8_t hi[256];
+  uint8_t lo[OPC_MAXGROUPS][16];
+  int ngroups;
+  bool shadowed;    // a row overlaps the low nibbles of a 16 bit opcode
+
+  constexpr opcode_dispatch_t(void) : hi(), lo(), ngroups(0), shadowed(false)
+  {
+    for ( int i = 0; i < 256; i++ )
+      hi[i] = OPC_NONE;
+    for ( int g = 0; g < OPC_MAXGROUPS; g++ )
+      for ( int n = 0; n < 16; n++ )
+        lo[g][n] = OPC_NONE;
+
+    // high bytes with 12/16 bit opcodes get a second level
+    for ( int i = 0; i < qnumber(opcodes); i++ )
+    {
+      const opcode_t &op = opcodes[i];
+      if ( op.opcode_size != S_12 && op.opcode_size != S_16 )
+        continue;
+      int h = (op.opcode << opcode_shift(op.opcode_size)) >> 8;
+      if ( hi[h] == OPC_NONE && ngroups < OPC_MAXGROUPS )
+        hi[h] = uint8_t(OPC_GROUP + ngroups++);
+    }
+
+    for ( int i = 0; i < qnumber(opcodes); i++ )
+    {
+      const opcode_t &op = opcodes[i];
+      int first = op.opcode << opcode_shift(op.opcode_size);
+      int last = first + (1 << opcode_shift(op.opcode_size));
+      for ( int data = first; data < last; data += 16 )
+      {
+        int h = data >> 8;
+        if ( hi[h] < OPC_GROUP )
+          continue;
+        if ( hi[h] == OPC_NONE )
+        {
+          hi[h] = uint8_t(i);
+          continue;
+        }
+        uint8_t &slot = lo[hi[h] - OPC_GROUP][(data >> 4) & 0xF];
+        if ( slot == OPC_NONE )
+          slot = uint8_t(i);
+        else if ( opcodes[slot].opcode_size == S_16 )
+          shadowed = true;
+      }
+    }
+
+    for ( int h = 0; h < 256; h++ )
+    {
+      if ( hi[h] >= OPC_GROUP && hi[h] < OPC_SPECIAL )
+      {
+        for ( int n = 0; n < 16; n++ )
+          if ( lo[hi[h] - OPC_GROUP][n] == OPC_NONE && special_halfword((h << 8) | (n << 4)) )
+            lo[hi[h] - OPC_GROUP][n] = OPC_SPECIAL;
+      }
+      else if ( hi[h] == OPC_NONE && special_halfword(h << 8) )
+      {
+        hi[h] = OPC_SPECIAL;
+      }
+    }
+  }
+
+  // returns an index into opcodes[], OPC_SPECIAL or OPC_NONE.
+  constexpr int lookup(int data) const
+  {
+    int idx = hi[data >> 8];
+    if ( idx >= OPC_GROUP && idx < OPC_SPECIAL )
+    {
+      idx = lo[idx - OPC_GROUP][(data >> 4) & 0xF];
+      if ( idx < OPC_GROUP && opcodes[idx].opcode_size == S_16 && (data & 0xF) != 0 )
+        idx = OPC_NONE;
+    }
+    return idx;
+  }
+};
+
+static constexpr opcode_dispatch_t opcode_dispatch;
+static_assert(opcode_dispatch.ngroups < OPC_MAXGROUPS, "too many 12/16 bit opcode groups for the dispatch tables");
+static_assert(!opcode_dispatch.shadowed, "a row in opcodes[] overlaps a 16 bit opcode");
+
+const struct opcode_t * opcode_t::find(fr_ctx_t &c, int *_data)
+{
+  QASSERT(10002, _data != NULL);
+
+  int data = (*_data << 8) | fetch_byte(c, c.insn.size);
+  int idx = opcode_dispatch.lookup(data);
+  if ( idx >= qnumber(opcodes) )
+    return NULL;
+
+  c.insn.size++;
+  *_data = invert_word(data);
+  return &opcodes[idx];
+}
+
+// get general register.
+static int get_gr(const int num)
+{
+  QASSERT(10003, num >= 0 && num <= 15);
+  return num;
+}
+
+// get coprocessor register.
+static int get_cr(const int num)
+{
+  QASSERT(10004, num >= 0 && num <= 15);
+  return num + 16;
+}
+
+// get dedicated register.
+static int get_dr(int num)
+{
+  static const int drs[] =
+  {
+    rTBR,
+    rRP,
+    rSSP,
+    rUSP,
+    rMDH,
+    rMDL,
+    rBP,
+    rFCR,
+    rESR,
+    rReserved9,
+    rReserved10,
+    rReserved11,
+    rReserved12,
+    rReserved13,
+    rReserved14,
+    rDBR
+  };
+  QASSERT(10005, num >= 0 && num <= 15);
+  return drs[num];
+}
+
+// fill an operand as a register.
+static void set_reg(fr_op_t &op, int reg, uint8_t d_typ)
+{
+  op.type = FR_O_REG;
+  op.reg = (uint16_t)reg;
+  op.dtyp = d_typ;
+}
+
+// fill an operand as an immediate value.
+static void set_imm(fr_op_t &op, int imm, uint8_t d_typ)
+{
+  op.type = FR_O_IMM;
+  switch ( d_typ )
+  {
+    case FR_DT_BYTE:  op.value = (int8_t) imm; break;
+    case FR_DT_WORD:  op.value = (int16_t) imm; break;
+    case FR_DT_DWORD: op.value = imm; break;
+    default:       INTERR(10013);
+  }
+  op.dtyp = d_typ;
+}
+
+// fill an operand as an immediate value.
+static void set_imm_notrunc(fr_op_t &op, int imm, uint8_t d_typ)
+{
+  op.type = FR_O_IMM;
+  op.value = imm;
+  op.dtyp = d_typ;
+}
+
+// fill an operand as a phrase.
+static void set_phrase(fr_op_t &op, int type, int val, uint8_t d_typ)
+{
+  switch ( type )
+  {
+    case fIGR:       // indirect general register
+    case fIGRP:      // indirect general register with post-increment
+    case fIGRM:      // indirect general register with pre-decrement
+    case fR13RI:     // indirect displacement between R13 and a general register
+      op.reg = (uint16_t)val;
+      break;
+
+    case fIRA:       // indirect relative address
+      op.addr = val;
+      break;
+
+    default:
+      INTERR(10014);
+  }
+  op.type = FR_O_PHRASE;
+  op.specflag2 = (char)type;
+  op.dtyp = d_typ;
+}
+
+// fill an operand as a relative address.
+static void set_rel(fr_ctx_t &c, fr_op_t &op, int addr, uint8_t d_typ, bool neg = false, bool trunc = false)
+{
+  op.type = FR_O_NEAR;
+  int raddr = addr;
+
+  if (trunc)
+  {
+    switch ( d_typ ) /* ugly but functional */
+    {
+    case FR_DT_BYTE:
+      raddr = ((signed char) addr);
+      break;
+
+    case FR_DT_WORD:
+      raddr = ((signed short) addr);
+      break;
+
+    default:
+      INTERR(10015);
+    }
+  }
+  op.addr = c.insn.ea + 2 + (neg ? -(raddr << 1) : (raddr << 1));
+  op.dtyp = d_typ;
+  //msg("0x%a set_rel: 0x%a = 0x%a + 2 + ((signed) 0x%X) * 2)\n", c.insn.ea, op.addr, c.insn.ea, addr);
+}
+
+// fill an operand as a reglist
+static void set_reglist(fr_op_t &op, int list)
+{
+  op.type = FR_O_REGLIST;
+  op.value = list;
+  op.dtyp = FR_DT_BYTE;  // list is coded in a byte
+}
+
+/**
+ * Return the dt_ value for the given table entry.  
+ * @param flags 
+ * 
+ * @todo Do we want the largest or smallest type here if multiple exist?  
+ * Some have an IMM_4 and a MEM_16 marked
+ */
+static uint8_t get_fr_dtyp(int flags, uint8_t defaultval)
+{
+  if( (flags & I_MEM_8) != 0 )
+    return FR_DT_BYTE;
+  if( (flags & I_MEM_16) != 0 )
+    return FR_DT_WORD;
+  if( (flags & I_MEM_32) != 0 )
+    return FR_DT_DWORD;
+
+  return defaultval;
+}
+
+static void set_displ(fr_op_t &op, int reg, int imm, int flag, int local_flag)
+{
+  op.type = FR_O_DISPL;
+
+  if ( reg != -1) op.reg = (uint16_t)get_gr(reg );
+  if ( imm != -1 )
+  {
+    int mul = 1;
+    if ( local_flag & I_IMM_2 ) mul = 2;
+    if ( local_flag & I_IMM_4 ) mul = 4;
+    if(flag == OP_DISPL_IMM_R14)
+    {
+      imm |= (imm & 0x80) ? (~0xff) : 0;
+    }
+
+    op.value = ((unsigned) imm) * mul;
+  }
+  op.dtyp = get_fr_dtyp(local_flag, FR_DT_DWORD);
+  op.specflag1 |= flag;
+}
+
+// swap 2 opcodes (o1 <=> o2).
+static void swap_ops(fr_op_t &o1, fr_op_t &o2)
+{
+  QASSERT(10006, o1.type != FR_O_VOID && o2.type != FR_O_VOID);
+  fr_op_t tmp = o1;
+  o1 = o2;
+  o2 = tmp;
+}
+
+static void adjust_data(int size, int *data)
+{
+  QASSERT(10007, data != NULL);
+  int new_data = *data >> bits[size];
+  *data = new_data;
+}
+
+#define SWAP_IF_BYTE(data)          \
+    do                              \
+    {                               \
+      if ( operand_size == S_8 )    \
+      {                             \
+        int h = (data & 0x0F) << 4; \
+        int l = (data & 0xF0) >> 4; \
+        data = h | l;               \
+      }                             \
+    }                               \
+    while ( 0 )
+
+//
+// defines some shortcuts.
+//
+
+//#define __set_gr(op, reg)               set_reg(op, reg, FR_DT_BYTE)
+//#define set_gr(op, reg)                 __set_gr(op, get_gr(reg))
+#define __set_dr(op, reg)               set_reg(op, reg, FR_DT_WORD)
+#define set_dr(op, reg)                 __set_dr(op, get_dr(reg))
+#define __set_cr(op, reg)               set_reg(op, reg, FR_DT_WORD)
+#define set_cr(op, reg)                 __set_cr(op, get_cr(reg))
+
+#define set_gri(op, reg, flags)                set_phrase(op, fIGR, get_gr(reg), get_fr_dtyp(flags, FR_DT_DWORD))
+#define set_grip(op, reg, flags)               set_phrase(op, fIGRP, get_gr(reg), get_fr_dtyp(flags, FR_DT_DWORD))
+#define set_grim(op, reg, flags)               set_phrase(op, fIGRM, get_gr(reg), get_fr_dtyp(flags, FR_DT_DWORD))
+#define set_diri(op, addr)              set_phrase(op, fIRA, addr, FR_DT_WORD)
+#define set_r13_gr_i(op, reg)           set_phrase(op, fR13RI, get_gr(reg), FR_DT_BYTE)
+#define fill_op1(data, opc)             fill_op(c, data, c.insn.ops[0], opc->op1, opc->op1_size, opc->flags)
+#define fill_op2(data, opc)             fill_op(c, data, c.insn.ops[1], opc->op2, opc->op2_size, opc->flags)
+#define fill_op3(data, opc)             fill_op(c, data, c.insn.ops[2], opc->op3, 0, opc->flags)
+//#define set_displ_gr(op, gr, f1)        set_displ(op, gr, -1, f1, 0)
+#define set_displ_imm(op, imm, f1, f2)  set_displ(op, -1, imm, f1, f2)
+
+
+
+static void fill_op(fr_ctx_t &c, int data, fr_op_t &op, int operand, int operand_size, int flags)
+{
+  data &= masks[operand_size];
+  //prepare_data(operand_size, &data);
+  switch ( operand )
+  {
+  case O_gr:           // general register                         Ri
+    QASSERT(10009, operand_size == S_4);
+    set_reg(op, get_gr(data), get_fr_dtyp(flags, FR_DT_DWORD));
+    break;
+
+  case O_gri:          // general register indirect                @Ri
+    QASSERT(10010, operand_size == S_4);
+    set_gri(op, data, flags);
+    break;
+
+  case O_grip:          // general register indirect                @Ri
+    QASSERT(10011, operand_size == S_4);
+    set_grip(op, data, flags);
+    break;
+
+  case O_r13_gr_i:     // indirect r13 + general register          @(R13, Ri)
+    set_r13_gr_i(op, data);
+    break;
+
+  case O_r14_imm8_i:   // indirect r14 + 8 bits immediate value    @(R14, imm)
+    SWAP_IF_BYTE(data);
+    set_displ_imm(op, data, OP_DISPL_IMM_R14, flags);
+    break;
+
+  case O_r15_imm4_i:   // indirect r15 + 4 bits immediate value    @(R15, imm)
+    SWAP_IF_BYTE(data);
+    set_displ_imm(op, data, OP_DISPL_IMM_R15, flags);
+    break;
+
+  case O_r15ip:        // indirect r15 post-increment              @R15+
+    set_grip(op, rR15, flags);
+    break;
+
+  case O_r15im:        // indirect r15 pre-decrement               @-R15
+    set_grim(op, rR15, flags);
+    break;
+
+  case O_r13:          // register r13                             R13
+    set_reg(c.insn.ops[3], rR13, FR_DT_DWORD);
+    break;
+
+  case O_r13ip:        // indirect r13 post-increment              @R13+
+    set_grip(op, rR13, flags);
+    break;
+
+  case O_dr:           // dedicated register                       Rs
+    set_dr(op, data);
+    break;
+
+  case O_ps:           // program status register (PS)             PS
+    __set_dr(op, rPS);
+    break;
+
+  case O_imm:          // immediate value                          #i
+    {
+      bool notrunc = false;
+      SWAP_IF_BYTE(data);
+      if ( c.insn.itype == fr_enter ) { data = ((unsigned) data ) * 4; notrunc = true; }
+      if ( c.insn.itype == fr_addsp) { data = ((signed) data ) * 4; notrunc = true; }
+      if ( flags & I_IMM_16 ) data += 16;
+
+      if ( c.insn.itype == fr_add2 || c.insn.itype == fr_addn2 || c.insn.itype == fr_cmp2 )   
+      {
+        data |= ~0xF; // sign extend
+        op.specflag1 = OP_IMM_SIGNED; 
+        notrunc = true;
+      }
+
+      if( notrunc )
+        set_imm_notrunc(op, data, dtypes[operand_size]);
+      else
+        set_imm(op, data, dtypes[operand_size]);
+    }
+    break;
+
+  case O_diri:         // indirect direct value                    @i
+    SWAP_IF_BYTE(data);
+    if ( c.insn.itype == fr_dmov )   data *= 4;
+    if ( c.insn.itype == fr_dmovh )  data *= 2;
+    set_diri(op, data);
+    op.specflag1 |= flags;
+    break;
+
+  case O_rel:          // relative value                           label5
+    SWAP_IF_BYTE(data);
+    set_rel(c, op, data, dtypes[operand_size]);
+    break;
+
+  case O_reglist:      // register list                            (R0, R1, R2, ...)
+    SWAP_IF_BYTE(data);
+    set_reglist(op, data);
+    break;
+
+  case O_null:         // null opcode
+    INTERR(10016);
+  }
+}
+
+// analyze a "common" instruction (those which are listed in the opcodes[] array).
+static bool ana_common(fr_ctx_t &c, int data)
+{
+  const struct opcode_t *op = opcode_t::find(c, &data);
+  if ( op == NULL )
+    return false;
+
+  // fill instruction type
+  c.insn.itype = (uint16_t)op->insn;
+
+  // Fill in some immediates and the TBR register for INTE. 
+  // These aren't used now, but I plan on performing TBR
+  // value tracking and can use this to generate offsets 
+  // to the current interrupt actually being called in a 
+  // fully analyzed ROM. 
+  if (op->implied())
+  {
+    if (c.insn.itype == fr_inte)
+    {
+      c.insn.ops[0].type = FR_O_IMM;
+      c.insn.ops[0].dtyp = FR_DT_DWORD;
+      c.insn.ops[0].value = 0x3d8;
+      c.insn.ops[0].addr = 0xffc00 + 0x3d8;
+      c.insn.ops[0].shown = false;
+      c.insn.ops[1].type = FR_O_REG;
+      c.insn.ops[1].reg = rTBR;
+      c.insn.ops[1].dtyp = FR_DT_DWORD;
+      c.insn.ops[1].addr = 0xffc00;
+      c.insn.ops[1].shown = false;
+    }
+
+    c.insn.auxpref = 0;
+    if (op->delay_shot())
+      c.insn.auxpref |= INSN_DELAY_SHOT;
+
+    return true;
+  }
+
+  adjust_data(op->opcode_size, &data);
+
+  // fill operand 1
+  if ( op->op1 != O_null )
+  {
+    fill_op1(data, op);
+    adjust_data(op->op1_size, &data);
+  }
+
+
+  if (c.insn.itype == fr_int)
+  {
+    c.insn.ops[0].dtyp = FR_DT_BYTE;
+    // Store the calculated initial value in the address field. 
+    // TODO:  Treat TBR as something like a segment register or
+    // the ARM / THUMB toggle in the arm disassembler... 
+    c.insn.ops[0].addr = 0xffc00 + 0x3fc - (c.insn.ops[0].value * 4);
+    c.insn.ops[1].type = FR_O_IMM;
+    c.insn.ops[1].dtyp = FR_DT_WORD;    
+    c.insn.ops[1].shown = false;
+    c.insn.ops[1].value = 0x3fc;
+    c.insn.ops[2].type = FR_O_REG;
+    c.insn.ops[2].dtyp = FR_DT_DWORD;
+    c.insn.ops[2].reg = rTBR;
+    c.insn.ops[2].value = 0x1fc00;
+    c.insn.ops[2].shown = false;
+
+    c.insn.auxpref = 0;
+    return true;
+  }
+  // fill operand 2
+  if ( op->op2 != O_null )
+  {
+    fill_op2(data, op);
+    adjust_data(op->op2_size, &data);
+  }
+
+  // fill operand 3, don't show it.  Used to track some implicits.
+  if (op->op3 != O_null)
+  {
+    fill_op3(data, op);
+    c.insn.ops[2].shown = false;
+  }
+
+  // swap opcodes if needed
+  if ( op->swap_ops() )
+    swap_ops(c.insn.ops[0], c.insn.ops[1]);
+
+  c.insn.auxpref = 0;
+
+  // is insn delay shot ?
+  if (op->delay_shot())
+    c.insn.auxpref |= INSN_DELAY_SHOT;
+  return true;
+}
+
+// FR81 extension instructions.
+//
+// They are all 32 bits long and their first halfword starts with 0x07 or
+// 0x17.  Their operand fields do not fit the nibble packing of opcodes[]
+// so the rows below match the whole first halfword against a mask and
+// describe where each operand comes from.  The encoding formats are
+// J: [15:0] = 12 bit opcode, 4 bit Ri/FRi/cc
+//    [15:0] = u16/rel16
+// K: [15:0] = 14 bit opcode, 2 bit o14/u14/-
+//    [15:0] = 12 bit o14/u14/-, 4 bit FRi
+// M: [15:0] = 16 bit opcode
+//    [15:0] = 0000, 4 bit FRk/-, 4 bit FRj/-, 4 bit FRi/-
+// N: [15:0] = 14 bit opcode, 00
+//    [15:0] = 16 bit frlist
+//
+// lcall (0x0730/0x1730) shares its encoding with mov FRi <-> Ri and is
+// not decoded.
+
+// distinct FR81 operands :
+enum
+{
+    F_null,         // null operand
+    F_frk,          // FRk, extension bits 8..11                FRk
+    F_frj,          // FRj, extension bits 4..7                 FRj
+    F_fri,          // FRi, extension bits 0..3                 FRi
+    F_fr,           // FRi, first halfword bits 0..3            FRi
+    F_gr,           // Ri, first halfword bits 0..3             Ri
+    F_gri,          // general register indirect                @Ri
+    F_r13_gr_i,     // indirect r13 + general register          @(R13, Ri)
+    F_r14_o14_i,    // indirect r14 + signed 14 bits * 4        @(R14, #o16)
+    F_r15_u14_i,    // indirect r15 + unsigned 14 bits * 4      @(R15, #u16)
+    F_r15ip,        // indirect r15 post-increment              @R15+
+    F_r15im,        // indirect r15 pre-decrement               @-R15
+    F_bp_u16_i,     // indirect bp + unsigned 16 bits           @(BP, #u16)
+    F_rel16,        // relative value                           label17
+    F_frlist,       // fpu register list                        (FR0, FR1, ...)
+};
+
+// structure of an FR81 opcode :
+struct fr81_opcode_t
+{
+  int insn;
+  int opcode;       // first halfword
+  int mask;         // bits of the first halfword compared against opcode
+  int op1;
+  int op2;
+  int op3;
+  int flags;        // I_SWAPOPS, I_DSHOT, I_IMM_x and I_MEM_x as in opcodes[]
+};
+
+static constexpr struct fr81_opcode_t fr81_opcodes[] =
+{
+  { fr_fbn,           0x07F0,   0xFFFF,   F_null,         F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbu,           0x07F1,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbg,           0x07F2,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbug,          0x07F3,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbl,           0x07F4,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbul,          0x07F5,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fblg,          0x07F6,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbne,          0x07F7,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbe,           0x07F8,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbue,          0x07F9,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbge,          0x07FA,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbuge,         0x07FB,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fble,          0x07FC,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbule,         0x07FD,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbo,           0x07FE,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fba,           0x07FF,   0xFFFF,   F_rel16,        F_null,     F_null,   I_BAD_DELAY },
+  { fr_fbn,           0x17F0,   0xFFFF,   F_null,         F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbu,           0x17F1,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbg,           0x17F2,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbug,          0x17F3,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbl,           0x17F4,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbul,          0x17F5,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fblg,          0x17F6,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbne,          0x17F7,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbe,           0x17F8,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbue,          0x17F9,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbge,          0x17FA,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbuge,         0x17FB,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fble,          0x17FC,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbule,         0x17FD,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fbo,           0x17FE,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fba,           0x17FF,   0xFFFF,   F_rel16,        F_null,     F_null,   I_DSHOT | I_BAD_DELAY },
+  { fr_fld,           0x07C0,   0xFFF0,   F_gri,          F_fri,      F_null,   0         },
+  { fr_fst,           0x17C0,   0xFFF0,   F_gri,          F_fri,      F_null,   I_SWAPOPS },
+  { fr_fld,           0x07D0,   0xFFFC,   F_r14_o14_i,    F_fri,      F_null,   0         },
+  { fr_fst,           0x17D0,   0xFFFC,   F_r14_o14_i,    F_fri,      F_null,   I_SWAPOPS },
+  { fr_fld,           0x07D4,   0xFFFC,   F_r15_u14_i,    F_fri,      F_null,   0         },
+  { fr_fst,           0x17D4,   0xFFFC,   F_r15_u14_i,    F_fri,      F_null,   I_SWAPOPS },
+  { fr_fld,           0x07D8,   0xFFFC,   F_r15ip,        F_fri,      F_null,   0         },
+  { fr_fst,           0x17D8,   0xFFFC,   F_r15im,        F_fri,      F_null,   I_SWAPOPS },
+  { fr_fldm,          0x07DC,   0xFFFC,   F_frlist,       F_r15ip,    F_null,   0         },
+  { fr_fstm,          0x17DC,   0xFFFC,   F_frlist,       F_r15im,    F_null,   0         },
+  { fr_fld,           0x07E0,   0xFFF0,   F_r13_gr_i,     F_fri,      F_null,   0         },
+  { fr_fst,           0x17E0,   0xFFF0,   F_r13_gr_i,     F_fri,      F_null,   I_SWAPOPS },
+  { fr_fldbp,         0x0770,   0xFFF0,   F_bp_u16_i,     F_fr,       F_null,   I_IMM_4   },
+  { fr_fstbp,         0x1770,   0xFFF0,   F_bp_u16_i,     F_fr,       F_null,   I_IMM_4 | I_SWAPOPS },
+  { fr_mov_to_fpr,    0x0730,   0xFFF0,   F_fri,          F_gr,       F_null,   0         },
+  { fr_mov_from_fpr,  0x1730,   0xFFF0,   F_fri,          F_gr,       F_null,   I_SWAPOPS },
+  { fr_ld_bp,         0x0740,   0xFFF0,   F_bp_u16_i,     F_gr,       F_null,   I_IMM_4 | I_MEM_32 },
+  { fr_lduh_bp,       0x0750,   0xFFF0,   F_bp_u16_i,     F_gr,       F_null,   I_IMM_2 | I_MEM_16 },
+  { fr_ldub_bp,       0x0760,   0xFFF0,   F_bp_u16_i,     F_gr,       F_null,   I_MEM_8   },
+  { fr_st_bp,         0x1740,   0xFFF0,   F_bp_u16_i,     F_gr,       F_null,   I_IMM_4 | I_MEM_32 | I_SWAPOPS },
+  { fr_sth_bp,        0x1750,   0xFFF0,   F_bp_u16_i,     F_gr,       F_null,   I_IMM_2 | I_MEM_16 | I_SWAPOPS },
+  { fr_stb_bp,        0x1760,   0xFFF0,   F_bp_u16_i,     F_gr,       F_null,   I_MEM_8 | I_SWAPOPS },
+  { fr_fadds,         0x07A0,   0xFFFF,   F_frk,          F_frj,      F_fri,    0         },
+  { fr_fsubs,         0x07A2,   0xFFFF,   F_frk,          F_frj,      F_fri,    0         },
+  { fr_fcmps,         0x07A4,   0xFFFF,   F_frk,          F_frj,      F_null,   0         },
+  { fr_fmadds,        0x07A5,   0xFFFF,   F_frk,          F_frj,      F_fri,    0         },
+  { fr_fmsubs,        0x07A6,   0xFFFF,   F_frk,          F_frj,      F_fri,    0         },
+  { fr_fmuls,         0x07A7,   0xFFFF,   F_frk,          F_frj,      F_fri,    0         },
+  { fr_fitos,         0x07A8,   0xFFFF,   F_frj,          F_fri,      F_null,   0         },
+  { fr_fstoi,         0x07A9,   0xFFFF,   F_frj,          F_fri,      F_null,   0         },
+  { fr_fdivs,         0x07AA,   0xFFFF,   F_frk,          F_frj,      F_fri,    0         },
+  { fr_fsqrts,        0x07AB,   0xFFFF,   F_frj,          F_fri,      F_null,   0         },
+  { fr_fabss,         0x07AC,   0xFFFF,   F_frj,          F_fri,      F_null,   0         },
+  { fr_fmovs,         0x07AE,   0xFFFF,   F_frj,          F_fri,      F_null,   0         },
+  { fr_fnegs,         0x07AF,   0xFFFF,   F_frj,          F_fri,      F_null,   0         },
+};
+
+// FR81 decode dispatch: indexed by the high byte of the first halfword
+// (0x07 or 0x17) and its low byte.  Holds the index of the first
+// fr81_opcodes[] row matching it or FR81_NONE.
+#define FR81_NONE   0xFF
+static_assert(qnumber(fr81_opcodes) < FR81_NONE, "fr81_opcodes[] is too large for the dispatch table");
+
+static constexpr bool fr81_opcodes_are_valid(void)
+{
+  for ( int i = 0; i < qnumber(fr81_opcodes); i++ )
+  {
+    const fr81_opcode_t &op = fr81_opcodes[i];
+    if ( (op.opcode & 0xEF00) != 0x0700 || (op.mask & 0xFF00) != 0xFF00 )
+      return false;
+    if ( (op.opcode & ~op.mask) != 0 )
+      return false;
+    if ( op.op1 == F_null && op.op2 != F_null )
+      return false;
+  }
+  return true;
+}
+static_assert(fr81_opcodes_are_valid(), "malformed row in fr81_opcodes[]");
+
+struct fr81_dispatch_t
+{
+  uint8_t idx[2][256];
+
+  constexpr fr81_dispatch_t(void) : idx()
+  {
+    for ( int h = 0; h < 2; h++ )
+    {
+      for ( int l = 0; l < 256; l++ )
+      {
+        int data = ((h ? 0x17 : 0x07) << 8) | l;
+        idx[h][l] = FR81_NONE;
+        for ( int i = 0; i < qnumber(fr81_opcodes); i++ )
+        {
+          if ( (data & fr81_opcodes[i].mask) == fr81_opcodes[i].opcode )
+          {
+            idx[h][l] = uint8_t(i);
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // returns the fr81_opcodes[] row for a first halfword, or NULL.
+  constexpr const fr81_opcode_t *lookup(int data) const
+  {
+    if ( (data & 0xEF00) != 0x0700 )
+      return NULL;
+    int i = idx[(data >> 12) & 1][data & 0xFF];
+    return i == FR81_NONE ? NULL : &fr81_opcodes[i];
+  }
+};
+
+static constexpr fr81_dispatch_t fr81_dispatch;
+
+// Halfwords which can not start the instruction in a delay slot, one bit
+// per first halfword: the rows of opcodes[] and fr81_opcodes[] flagged
+// I_BAD_DELAY, the other instructions decoded by ana_special(), and
+// halfwords which do not decode at all.  Generated from the dispatch
+// tables at compile time, so checking a slot is a bit test instead of a
+// second decode.
+struct bad_delay_map_t
+{
+  uint32_t bits[0x10000 / 32];
+
+  static constexpr bool is_bad(int data, int idx)
+  {
+    if ( idx == OPC_NONE )
+      return true;
+    if ( idx != OPC_SPECIAL )
+      return opcodes[idx].bad_delay();
+    if ( (data & 0xEF00) != 0x0700 )
+      return true;
+    const fr81_opcode_t *op = fr81_dispatch.lookup(data);
+    return op == NULL || (op->flags & I_BAD_DELAY) != 0;
+  }
+
+  constexpr bad_delay_map_t(void) : bits()
+  {
+    // lookup() only looks at the top 12 bits, and whether the low nibble
+    // is zero for 16 bit opcodes
+    for ( int data = 0; data < 0x10000; data += 16 )
+    {
+      int idx = opcode_dispatch.lookup(data);
+      bool bad0 = is_bad(data, idx);
+      bool bad = idx < OPC_GROUP && opcodes[idx].opcode_size == S_16 ? true : bad0;
+      uint32_t mask = (bad0 ? 1 : 0) | (bad ? 0xFFFE : 0);
+      bits[data >> 5] |= mask << (data & 16);
+    }
+    // the FR81 table (07xx and 17xx) looks at the whole halfword
+    for ( int h = 0x0700; h <= 0x1700; h += 0x1000 )
+    {
+      for ( int hw = h; hw < h + 0x100; hw++ )
+      {
+        if ( opcode_dispatch.lookup(hw) != OPC_SPECIAL )
+          continue;
+        if ( is_bad(hw, OPC_SPECIAL) )
+          bits[hw >> 5] |= uint32_t(1) << (hw & 31);
+        else
+          bits[hw >> 5] &= ~(uint32_t(1) << (hw & 31));
+      }
+    }
+  }
+
+  constexpr bool test(int data) const
+  {
+    return ((bits[data >> 5] >> (data & 31)) & 1) != 0;
+  }
+};
+
+static constexpr bad_delay_map_t bad_delay_map;
+// frclass.cpp decodes every halfword followed by zeros
+static_assert(!bad_delay_map.test(0x0000),
+              "the classification table needs 0000 to be valid in a delay slot");
+// FBcc and FBcc:D, an undecodable FR81 halfword, and an FR81 instruction
+// which is allowed
+static_assert(bad_delay_map.test(0x07F1) && bad_delay_map.test(0x17F1),
+              "fbu(:D) must be rejected in a delay slot");
+static_assert(fr81_dispatch.lookup(0x0720) == NULL && bad_delay_map.test(0x0720),
+              "undecodable 0720 must be rejected in a delay slot");
+static_assert(!bad_delay_map.test(0x07A0), "fadds must be allowed in a delay slot");
+
+// check the instruction in the delay slot of the delay shot instruction
+// decoded so far.
+static bool bad_delay_slot(fr_ctx_t &c)
+{
+  return bad_delay_map.test(fetch_word(c, c.insn.size));
+}
+
+// fill an FR81 operand.  data is the first halfword, ext the second one.
+static void fill_fr81_op(fr_ctx_t &c, fr_op_t &op, int operand, int data, int ext, int flags)
+{
+  switch ( operand )
+  {
+    case F_frk:
+      set_reg(op, rFR0 + ((ext >> 8) & 0xF), FR_DT_FLOAT);
+      break;
+
+    case F_frj:
+      set_reg(op, rFR0 + ((ext >> 4) & 0xF), FR_DT_FLOAT);
+      break;
+
+    case F_fri:
+      set_reg(op, rFR0 + (ext & 0xF), FR_DT_FLOAT);
+      break;
+
+    case F_fr:
+      set_reg(op, rFR0 + (data & 0xF), FR_DT_FLOAT);
+      break;
+
+    case F_gr:
+      set_reg(op, get_gr(data & 0xF), get_fr_dtyp(flags, FR_DT_DWORD));
+      break;
+
+    case F_gri:
+      set_phrase(op, fIGR, get_gr(data & 0xF), FR_DT_FLOAT);
+      break;
+
+    case F_r13_gr_i:
+      set_phrase(op, fR13RI, get_gr(data & 0xF), FR_DT_FLOAT);
+      break;
+
+    case F_r14_o14_i:
+    case F_r15_u14_i:
+      {
+        int imm = (((data & 3) << 12) | ((ext & 0xFFF0) >> 4)) << 2;
+        op.type = FR_O_DISPL;
+        op.dtyp = FR_DT_FLOAT;
+        if ( operand == F_r14_o14_i )
+        {
+          // sign extend
+          if ( imm & 0x8000 )
+            imm |= ~0xFFFF;
+          op.specflag1 |= OP_DISPL_IMM_R14;
+        }
+        else
+        {
+          op.specflag1 |= OP_DISPL_IMM_R15;
+        }
+        op.value = (unsigned)imm;
+      }
+      break;
+
+    case F_r15ip:
+      set_phrase(op, fIGRP, rR15, FR_DT_FLOAT);
+      break;
+
+    case F_r15im:
+      set_phrase(op, fIGRM, rR15, FR_DT_FLOAT);
+      break;
+
+    case F_bp_u16_i:
+      {
+        int mul = 1;
+        if ( flags & I_IMM_2 ) mul = 2;
+        if ( flags & I_IMM_4 ) mul = 4;
+        op.type = FR_O_DISPL;
+        op.dtyp = get_fr_dtyp(flags, FR_DT_FLOAT);
+        op.value = ((unsigned) ext) * mul;
+        op.specflag1 |= OP_DISPL_IMM_BP;
+      }
+      break;
+
+    case F_rel16:
+      set_rel(c, op, ext, FR_DT_WORD, false, true);
+      break;
+
+    case F_frlist:
+      op.type = FR_O_REGLIST;
+      op.value = ext;
+      op.dtyp = FR_DT_WORD;  // list is coded in 16 bits
+      break;
+
+    default:
+      INTERR(10022);
+  }
+}
+
+// analyze an FR81 extension instruction (those listed in the fr81_opcodes[] array).
+static bool ana_fr81(fr_ctx_t &c, int data)
+{
+  const struct fr81_opcode_t *op = fr81_dispatch.lookup(data);
+  if ( op == NULL )
+    return false;
+
+  c.insn.size++;
+  int ext = next_word(c);
+
+  c.insn.itype = (uint16_t)op->insn;
+  if ( op->op1 != F_null )
+    fill_fr81_op(c, c.insn.ops[0], op->op1, data, ext, op->flags);
+  if ( op->op2 != F_null )
+    fill_fr81_op(c, c.insn.ops[1], op->op2, data, ext, op->flags);
+  if ( op->op3 != F_null )
+    fill_fr81_op(c, c.insn.ops[2], op->op3, data, ext, op->flags);
+
+  if ( op->flags & I_SWAPOPS )
+    swap_ops(c.insn.ops[0], c.insn.ops[1]);
+
+  c.insn.auxpref = 0;
+  if ( op->flags & I_DSHOT )
+    c.insn.auxpref |= INSN_DELAY_SHOT;
+
+  return true;
+}
+
+// analyze a "special" instruction (those which are NOT listed in the opcodes[] array).
+static bool ana_special(fr_ctx_t &c, int data)
+{
+  // detect ldi:20 instructions
+  if ( data == 0x9B )
+  {
+    c.insn.itype = fr_ldi_20;
+    data = (data << 8) | next_byte(c);
+    set_reg(c.insn.ops[1], get_gr(data & 0x000F), FR_DT_DWORD);
+    set_imm(c.insn.ops[0], next_word(c) | ((data & 0x00F0) << 12), FR_DT_DWORD);
+    return true;
+  }
+
+  data = (data << 8) | fetch_byte(c, c.insn.size);
+
+  // FR81 extension instructions
+  if ( (data & 0xEF00) == 0x0700 )
+    return ana_fr81(c, data);
+
+  // detect ldi:32 instructions
+  if ( (data & 0xFFF0) == 0x9F80 )
+  {
+    c.insn.size++;
+    c.insn.itype = fr_ldi_32;
+    set_reg(c.insn.ops[1], get_gr(data & 0x000F), FR_DT_DWORD);
+    set_imm(c.insn.ops[0], next_long(c), FR_DT_DWORD);
+    return true;
+  }
+
+  // detect call [rel] instructions
+  int tmp = (data & 0xF800) >> 11;
+  if ( tmp == 0x1A || tmp == 0x1B )
+  {
+    c.insn.itype = fr_call;
+    c.insn.size++;
+
+    // extend sign
+    set_rel(c, c.insn.ops[0], data & 0x07ff, FR_DT_WORD, (data & 0x400));
+    if ( tmp == 0x1B )
+        c.insn.auxpref |= INSN_DELAY_SHOT;
+    return true;
+  }
+
+  // detect copop/copld/copst/copsv instructions
+  if ( ((data & 0xFF00) >> 8) == 0x9F )
+  {
+    int word = fetch_word(c, c.insn.size + 1);
+    c.insn.itype = fr_null;
+    switch ( (data & 0x00F0) >> 4 )
+    {
+      // copop
+      case 0xC:
+        c.insn.itype = fr_copop;
+        set_cr(c.insn.ops[2], (word & 0x00F0) >> 4);
+        set_cr(c.insn.ops[3], word & 0x000F);
+        break;
+
+      // copld
+      case 0xD:
+        c.insn.itype = fr_copld;
+        set_reg(c.insn.ops[2], get_gr((word & 0x00F0) >> 4), FR_DT_DWORD);
+        set_cr(c.insn.ops[3], word & 0x000F);
+        break;
+
+      // copst
+      case 0xE:
+        c.insn.itype = fr_copst;
+        set_cr(c.insn.ops[2], (word & 0x00F0) >> 4);
+        set_reg(c.insn.ops[3], get_gr(word & 0x000F), FR_DT_DWORD);
+        break;
+
+      // copsv
+      case 0xF:
+        c.insn.itype = fr_copsv;
+        set_cr(c.insn.ops[2], (word & 0x00F0) >> 4);
+        set_reg(c.insn.ops[3], get_gr(word & 0x000F), FR_DT_DWORD);
+        break;
+    }
+    if ( c.insn.itype != fr_null )
+    {
+      set_imm(c.insn.ops[0], data & 0x000F, FR_DT_BYTE);
+      set_imm(c.insn.ops[1], (word & 0xFF00) >> 8, FR_DT_BYTE);
+      c.insn.size += 3;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// decode the instruction at c.insn.ea.
+static bool ana_insn(fr_ctx_t &c)
+{
+  int byte = next_byte(c);
+
+  bool ok;
+  switch ( opcode_dispatch.lookup((byte << 8) | fetch_byte(c, c.insn.size)) )
+  {
+    case OPC_NONE:
+      return false;
+
+    case OPC_SPECIAL:
+      ok = ana_special(c, byte);
+      break;
+
+    default:
+      ok = ana_common(c, byte);
+      break;
+  }
+
+  // Check the next instruction for being disallowed in
+  // a delay slot, if so return false / bad analysis on
+  // this instruction.
+  if ( ok && (c.insn.auxpref & INSN_DELAY_SHOT) != 0 && bad_delay_slot(c) )
+  {
+    c.insn.auxpref |= INSN_BAD_DELAY;
+    return false;
+  }
+  return ok;
+}
+
+int fr_decode(fr_insn_t *insn, uint32_t ea, const uint8_t *bytes, size_t len)
+{
+  memset(insn, 0, sizeof(*insn));
+  insn->ea = ea;
+  for ( int i = 0; i < FR_MAXOP; i++ )
+    insn->ops[i].shown = true;
+
+  fr_ctx_t c = { *insn, bytes, len, false };
+  bool ok = ana_insn(c);
+  if ( c.short_read )
+    return FR_DECODE_SHORT;
+  return ok ? insn->size : 0;
+}
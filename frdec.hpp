@@ -0,0 +1,236 @@
+#ifndef __FRDEC_HPP
+#define __FRDEC_HPP
+
+// Fujitsu FR instruction decoder (frdec.cpp).
+//
+// Decodes a span of bytes at a given address into an fr_insn_t without
+// any help from the IDA kernel.  The operand types, data types and flags
+// use the same values as the processor module, so ana.cpp can copy an
+// fr_insn_t into cmd field by field.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ENUM_SIZE
+#define ENUM_SIZE(t)
+#endif
+#include "ins.hpp"
+
+// FR registers
+enum fr_registers {
+
+    // general purpose registers :
+
+    rR0,
+    rR1,
+    rR2,
+    rR3,
+    rR4,
+    rR5,
+    rR6,
+    rR7,
+    rR8,
+    rR9,
+    rR10,
+    rR11,
+    rR12,
+    rR13,
+    rR14,
+    rR15,
+
+    // coprocessor registers :
+
+    rCR0,
+    rCR1,
+    rCR2,
+    rCR3,
+    rCR4,
+    rCR5,
+    rCR6,
+    rCR7,
+    rCR8,
+    rCR9,
+    rCR10,
+    rCR11,
+    rCR12,
+    rCR13,
+    rCR14,
+    rCR15,
+
+    // dedicated registers :
+
+    rPC,        // program counter
+    rPS,        // program status
+    rTBR,       // table base register
+    rRP,        // return pointer
+    rSSP,       // system stack pointer
+    rUSP,       // user stack pointer
+    rMDL,       // multiplication/division register (LOW)
+    rMDH,       // multiplication/division register (HIGH)
+
+    // These aren't used on FR65 and below.
+    rBP,        // Base pointer for shorter addressing modes
+    rFCR,       // FPU control register
+    rESR,       // Exception status register
+
+    // system use dedicated registers
+    rReserved9,
+    rReserved10,
+    rReserved11,
+    rReserved12,
+    rReserved13,
+    rReserved14,
+    rReserved15,
+    rDBR,       // Debug register
+
+
+    // Floating point registers (FR81+)
+    rFR0,
+    rFR1,
+    rFR2,
+    rFR3,
+    rFR4,
+    rFR5,
+    rFR6,
+    rFR7,
+    rFR8,
+    rFR9,
+    rFR10,
+    rFR11,
+    rFR12,
+    rFR13,
+    rFR14,
+    rFR15,
+
+    // these 2 registers are required by the IDA kernel :
+    rVcs,
+    rVds,
+
+    // TBR value, tracked like a segment register (emu_tbr.cpp).
+    // it comes last to keep the sreg numbers of older databases.
+    rVtbr
+};
+
+enum fr_phrases {
+    fIGR,       // indirect general register
+    fIRA,       // indirect relative address
+    fIGRP,      // indirect general register with post-increment
+    fIGRM,      // indirect general register with pre-decrement
+    fR13RI,     // indirect displacement between R13 and a general register
+};
+
+// flags for insn.auxpref
+#define INSN_DELAY_SHOT        0x00000001           // postfix insn mnem by ":D"
+#define INSN_BAD_DELAY         0x00000002           // This is a bad instruction for delay slots
+
+// flags for op.specflag1
+#define OP_DISPL_IMM_R14       0x00000001           // @(R14, #i)
+#define OP_DISPL_IMM_R15       0x00000002           // @(R15, #u)
+#define OP_IMM_SIGNED          0x00000020           // IMM signed.
+#define OP_ADDR_R              0x00000010           // read-access to memory
+#define OP_ADDR_W              0x00000012           // write-access to memory
+#define OP_OFFSET_TBR          0x00000040           // Display an interrupt address relative to the TBR (default 0xFFC00)
+#define OP_DISPL_IMM_BP        0x00000080           // @(BP, #u)
+
+// operand types (same values as IDA's o_...)
+#define FR_O_VOID              0
+#define FR_O_REG               1
+#define FR_O_MEM               2
+#define FR_O_PHRASE            3
+#define FR_O_DISPL             4
+#define FR_O_IMM               5
+#define FR_O_FAR               6
+#define FR_O_NEAR              7
+#define FR_O_REGLIST           8                    // o_reglist
+
+// operand data types (same values as IDA's dt_...)
+#define FR_DT_BYTE             0
+#define FR_DT_WORD             1
+#define FR_DT_DWORD            2
+#define FR_DT_FLOAT            3
+
+#define FR_MAXOP               4                    // operands per instruction
+#define FR_MAXSIZE             6                    // longest instruction (ldi:32)
+
+// a decoded operand
+struct fr_op_t
+{
+  uint8_t type;         // FR_O_...
+  uint8_t dtyp;         // FR_DT_...
+  uint8_t specflag1;    // OP_...
+  uint8_t specflag2;    // fr_phrases for FR_O_PHRASE
+  uint16_t reg;         // fr_registers
+  bool shown;           // false for implicit operands
+  uint32_t value;
+  uint32_t addr;
+};
+
+// a decoded instruction
+struct fr_insn_t
+{
+  uint32_t ea;
+  uint16_t itype;       // nameNum
+  uint16_t size;
+  uint32_t auxpref;     // INSN_...
+  fr_op_t ops[FR_MAXOP];
+};
+
+// fr_decode() could not finish: the instruction continues past the bytes given
+#define FR_DECODE_SHORT        (-1)
+
+// decode the instruction at 'ea' whose bytes are bytes[0..len).
+// returns its size, 0 if it is not a valid instruction or FR_DECODE_SHORT.
+int fr_decode(fr_insn_t *insn, uint32_t ea, const uint8_t *bytes, size_t len);
+
+inline bool fr_is_ldi(int itype)
+{
+  return itype == fr_ldi_8 || itype == fr_ldi_20 || itype == fr_ldi_32;
+}
+
+// the value loaded by an ldi whose decoded operand is 'value'. the
+// decoder sign extends the ldi:8 operand, the chip zero extends it.
+inline uint32_t fr_ldi_value(int itype, uint32_t value)
+{
+  return itype == fr_ldi_8 ? value & 0xFF : value;
+}
+
+// Halfword classification (frclass.cpp).
+//
+// The class and size of an instruction only depend on its first
+// halfword, so a whole segment can be classified up front.
+#define FR_IC_COMMON           0                    // opcodes[]
+#define FR_IC_LDI20            1                    // ldi:20
+#define FR_IC_LDI32            2                    // ldi:32
+#define FR_IC_CALL             3                    // call(:D) rel
+#define FR_IC_COPROC           4                    // copop / copld / copst / copsv
+#define FR_IC_FR81             5                    // FR81 extensions
+#define FR_IC_INVALID          6                    // not an instruction
+#define FR_IC_LAST             7
+
+// classify the n halfwords of bytes[0..2*n).  classes[i] receives the
+// FR_IC_... class of an instruction starting at halfword i and sizes[i]
+// its size in bytes (0 for FR_IC_INVALID).  Either output may be NULL.
+void fr_classify(uint8_t *classes, uint8_t *sizes, const uint8_t *bytes, size_t n);
+
+// class and size of the instruction starting with halfword 'hw'.
+int fr_halfword_class(int hw);
+int fr_halfword_size(int hw);
+
+// Function prologue scan (frscan.cpp).
+//
+// Shared by the prologue scanner of the module and frbatch.
+#define FR_SCAN_MAXFUNC        0x10000              // bytes to the first return
+
+// does a function start at halfword i of bytes[0..2*n)?  sizes[] are the
+// fr_classify() sizes of the halfwords and base the address of bytes[0].
+// The function must follow the end of another one or start the span,
+// begin with a prologue and reach a return.
+bool fr_prologue_at(const uint8_t *bytes, const uint8_t *sizes, size_t n, size_t i, uint32_t base);
+
+// Analysis constants of the module and frbatch.
+#define FR_CALL_SPOILED        (0x00FF | (1 << rR12) | (1 << rR13))  // not preserved by a call
+#define FR_TBR_RESET           0x000FFC00           // TBR after reset
+#define FR_SW_WINDOW           16                   // instructions searched before a jmp
+#define FR_SW_MAXCASES         0x1000               // larger switch tables are not believed
+
+#endif /* __FRDEC_HPP */
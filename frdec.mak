@@ -0,0 +1,67 @@
+# Standalone build of the FR instruction decoder (frdec.cpp, frclass.cpp,
+# frscan.cpp).
+# It does not need the IDA SDK:
+#
+#       make -f frdec.mak
+#
+# builds libfrdec.a for use by tools outside of IDA, and
+#
+#       make -f frdec.mak frbench
+#
+# the decoder benchmark (frbench.cpp), and
+#
+#       make -f frdec.mak frbatch
+#
+# the headless batch analyzer (frbatch.cpp), and
+#
+#       make -f frdec.mak frtrace
+#
+# the decoder of the module's trace files (frtrace.cpp).
+
+CXX      ?= g++
+AR       ?= ar
+CXXFLAGS ?= -O2
+CXXFLAGS += -std=c++14 -Wall
+OBJDIR   ?= obj_frdec
+
+LIB       = $(OBJDIR)/libfrdec.a
+BENCH     = $(OBJDIR)/frbench
+BATCH     = $(OBJDIR)/frbatch
+TRACE     = $(OBJDIR)/frtrace
+
+all: $(LIB)
+
+$(OBJDIR):
+	mkdir -p $@
+
+$(OBJDIR)/frdec.o: frdec.cpp frdec.hpp ins.hpp | $(OBJDIR)
+	$(CXX) $(CXXFLAGS) -c -o $@ frdec.cpp
+
+$(OBJDIR)/frclass.o: frclass.cpp frdec.hpp ins.hpp | $(OBJDIR)
+	$(CXX) $(CXXFLAGS) -c -o $@ frclass.cpp
+
+$(OBJDIR)/frscan.o: frscan.cpp frdec.hpp ins.hpp | $(OBJDIR)
+	$(CXX) $(CXXFLAGS) -c -o $@ frscan.cpp
+
+$(LIB): $(OBJDIR)/frdec.o $(OBJDIR)/frclass.o $(OBJDIR)/frscan.o
+	$(AR) rcs $@ $^
+
+frbench: $(BENCH)
+
+$(BENCH): frbench.cpp frdec.hpp ins.hpp $(LIB) | $(OBJDIR)
+	$(CXX) $(CXXFLAGS) -o $@ frbench.cpp $(LIB)
+
+frbatch: $(BATCH)
+
+$(BATCH): frbatch.cpp frdec.hpp ins.hpp $(LIB) | $(OBJDIR)
+	$(CXX) $(CXXFLAGS) -pthread -o $@ frbatch.cpp $(LIB)
+
+frtrace: $(TRACE)
+
+$(TRACE): frtrace.cpp frtrace.hpp | $(OBJDIR)
+	$(CXX) $(CXXFLAGS) -o $@ frtrace.cpp
+
+clean:
+	rm -rf $(OBJDIR)
+
+.PHONY: all clean frbench frbatch frtrace
@@ -0,0 +1,130 @@
+// Function prologue scan.
+//
+// On stripped ROMs most functions are only called through ldi:32 and
+// call @Ri, so recursive descent never reaches them.  The module
+// (emu_scan.cpp) and frbatch walk the code linearly and ask
+// fr_prologue_at() about every halfword.  It looks for the prologues
+// create_func_frame() understands:
+//
+//      st rp, @-r15 / st Ri, @-r15 / stm0 / stm1   (any number of them)
+//      enter #n
+//      mov r15, r14 ; ldi:20/32 #n, r0
+//
+// A candidate must follow the end of another function (ret, reti, or
+// ret:D and its delay slot, optionally padded with nops) or start the
+// span, and decoding forward from it must reach ret / ret:D / reti
+// without an invalid instruction.  The forward walks only look at the
+// halfword size table of fr_classify().
+
+#ifdef __IDP__
+#include <pro.h>
+#endif
+#include "frdec.hpp"
+
+#define HW_RET            0x9720        // ret
+#define HW_RET_D          0x9F20        // ret:D
+#define HW_RETI           0x9730        // reti
+#define HW_NOP            0x9FA0        // nop
+
+// the halfwords scanned and their instruction sizes
+struct scan_span_t
+{
+  const uint8_t *bytes;
+  const uint8_t *sizes;
+  size_t n;                             // halfwords
+  uint32_t base;                        // address of bytes[0]
+
+  int hw(size_t i) const { return (bytes[2 * i] << 8) | bytes[2 * i + 1]; }
+  // decode the instruction at halfword i.
+  bool decode(size_t i, fr_insn_t *insn) const
+  {
+    if ( i >= n )
+      return false;
+    size_t len = (n - i) * 2 < FR_MAXSIZE ? (n - i) * 2 : FR_MAXSIZE;
+    return fr_decode(insn, uint32_t(base + i * 2), bytes + i * 2, len) > 0;
+  }
+};
+
+static bool is_return(int hw)
+{
+  return hw == HW_RET || hw == HW_RET_D || hw == HW_RETI;
+}
+
+// does halfword i follow the end of a function?
+static bool after_function_end(const scan_span_t &s, size_t i)
+{
+  while ( i > 0 && s.hw(i - 1) == HW_NOP )
+    i--;
+  if ( i == 0 )
+    return true;
+  int prev = s.hw(i - 1);
+  if ( prev == HW_RET || prev == HW_RETI )
+    return true;
+  // ret:D and a one halfword delay slot
+  return i >= 2 && s.hw(i - 2) == HW_RET_D && s.sizes[i - 1] == 2;
+}
+
+// is there a prologue at halfword i? returns the halfword after it or 0.
+static size_t match_prologue(const scan_span_t &s, size_t i)
+{
+  fr_insn_t insn;
+  size_t saves = 0;
+  for ( ;; i += insn.size / 2 )
+  {
+    if ( !s.decode(i, &insn) )
+      return 0;
+    bool push = insn.itype == fr_st
+             && insn.ops[1].type == FR_O_PHRASE
+             && insn.ops[1].reg == rR15
+             && insn.ops[1].specflag2 == fIGRM
+             && insn.ops[0].type == FR_O_REG
+             && (insn.ops[0].reg <= rR14 || insn.ops[0].reg == rRP);
+    bool stm = (insn.itype == fr_stm0 || insn.itype == fr_stm1)
+            && insn.ops[0].value != 0;
+    if ( !push && !stm )
+      break;
+    saves++;
+  }
+
+  if ( insn.itype == fr_enter )
+    return i + 1;
+
+  if ( insn.itype == fr_mov
+    && insn.ops[0].type == FR_O_REG && insn.ops[0].reg == rR15
+    && insn.ops[1].type == FR_O_REG && insn.ops[1].reg == rR14 )
+  {
+    size_t next = i + 1;
+    if ( s.decode(next, &insn)
+      && (insn.itype == fr_ldi_20 || insn.itype == fr_ldi_32)
+      && insn.ops[1].type == FR_O_REG && insn.ops[1].reg == rR0 )
+    {
+      return next + insn.size / 2;
+    }
+  }
+  return saves != 0 ? i : 0;
+}
+
+// does decoding forward from halfword i reach a return?
+static bool reaches_return(const scan_span_t &s, size_t i)
+{
+  size_t end = i + FR_SCAN_MAXFUNC / 2 < s.n ? i + FR_SCAN_MAXFUNC / 2 : s.n;
+  while ( i < end )
+  {
+    int size = s.sizes[i];
+    if ( size == 0 )
+      return false;
+    if ( is_return(s.hw(i)) )
+      return true;
+    i += size / 2;
+  }
+  return false;
+}
+
+bool fr_prologue_at(const uint8_t *bytes, const uint8_t *sizes, size_t n, size_t i, uint32_t base)
+{
+  scan_span_t s = { bytes, sizes, n, base };
+  if ( i >= n || sizes[i] == 0 || !after_function_end(s, i) )
+    return false;
+  size_t body = match_prologue(s, i);
+  return body != 0 && reaches_return(s, body);
+}
@@ -0,0 +1,200 @@
+// Trace file decoder.
+//
+// Prints the records of the trace files written by the processor module
+// with FR_SWITCH_DEBUG or FR_TYPE_DEBUG (see frtrace.hpp), optionally
+// only some events or addresses, or how many records each event has.
+//
+//       make -f frdec.mak frtrace
+//       ./obj_frdec/frtrace [-e event,...] [-a ea[-end]] [-c] file.frtrace...
+//
+// -e keeps the named events; a name ending with '.' keeps a group
+//    ("sw." or "type.").
+// -a keeps the records whose ea is ea, or in [ea, end).
+// -c prints the number of records of each event instead of the records.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "frtrace.hpp"
+
+struct event_info_t
+{
+  const char *name;
+  const char *args[3];
+};
+
+#define FR_TRACE_INFO(id, name, a, b, c) { name, { a, b, c } },
+static const event_info_t events[FR_EV_LAST] =
+{
+  FR_TRACE_EVENTS(FR_TRACE_INFO)
+};
+#undef FR_TRACE_INFO
+
+static bool keep[FR_EV_LAST];
+static bool by_ea;
+static uint32_t ea_lo;                   // [ea_lo, ea_hi] with -a
+static uint32_t ea_hi;
+static bool counts_only;
+static uint64_t counts[FR_EV_LAST];
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: frtrace [-e event,...] [-a ea[-end]] [-c] file.frtrace...\n");
+  exit(2);
+}
+
+// select the events named in a comma separated list.
+static void select_events(const char *list)
+{
+  std::string s(list);
+  size_t pos = 0;
+  while ( pos <= s.size() )
+  {
+    size_t comma = s.find(',', pos);
+    if ( comma == std::string::npos )
+      comma = s.size();
+    std::string name = s.substr(pos, comma - pos);
+    bool group = !name.empty() && name[name.size() - 1] == '.';
+    bool found = false;
+    for ( int i = 0; i < FR_EV_LAST; i++ )
+    {
+      if ( group ? strncmp(events[i].name, name.c_str(), name.size()) == 0
+                 : name == events[i].name )
+      {
+        keep[i] = true;
+        found = true;
+      }
+    }
+    if ( !found )
+    {
+      fprintf(stderr, "frtrace: unknown event '%s'\n", name.c_str());
+      exit(2);
+    }
+    pos = comma + 1;
+  }
+}
+
+static void print_record(const fr_trace_rec_t &r)
+{
+  const event_info_t &e = events[r.event];
+  printf("%10u %08X %s", r.seq, r.ea, e.name);
+  const uint32_t vals[3] = { r.a, r.b, r.c };
+  int pad = 18 - int(strlen(e.name));
+  for ( int i = 0; i < 3; i++ )
+  {
+    if ( e.args[i] != NULL )
+    {
+      printf("%*s %s=%#x", pad > 0 ? pad : 0, "", e.args[i], vals[i]);
+      pad = 0;
+    }
+  }
+  printf("\n");
+}
+
+// print or count the records of a file. returns false on a bad file.
+static bool read_trace(const char *path)
+{
+  FILE *fp = fopen(path, "rb");
+  if ( fp == NULL )
+  {
+    perror(path);
+    return false;
+  }
+  fr_trace_header_t h;
+  if ( fread(&h, sizeof(h), 1, fp) != 1
+    || h.magic != FR_TRACE_MAGIC
+    || h.version != FR_TRACE_VERSION
+    || h.recsize != sizeof(fr_trace_rec_t) )
+  {
+    fprintf(stderr, "%s: not an FR trace file of this version and byte order\n", path);
+    fclose(fp);
+    return false;
+  }
+
+  fr_trace_rec_t r;
+  while ( fread(&r, sizeof(r), 1, fp) == 1 )
+  {
+    if ( r.event >= FR_EV_LAST )
+    {
+      fprintf(stderr, "%s: bad event %u in record %u\n", path, r.event, r.seq);
+      continue;
+    }
+    // dropped records are always shown
+    if ( r.event != FR_EV_DROPPED )
+    {
+      if ( !keep[r.event] )
+        continue;
+      if ( by_ea && (r.ea < ea_lo || r.ea > ea_hi) )
+        continue;
+    }
+    if ( counts_only )
+      counts[r.event]++;
+    else
+      print_record(r);
+  }
+  fclose(fp);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  bool selected = false;
+  std::vector<const char *> files;
+  for ( int i = 1; i < argc; i++ )
+  {
+    const char *arg = argv[i];
+    if ( strcmp(arg, "-e") == 0 && i + 1 < argc )
+    {
+      select_events(argv[++i]);
+      selected = true;
+    }
+    else if ( strcmp(arg, "-a") == 0 && i + 1 < argc )
+    {
+      char *end;
+      ea_lo = uint32_t(strtoul(argv[++i], &end, 16));
+      ea_hi = ea_lo;
+      if ( *end == '-' )
+      {
+        ea_hi = uint32_t(strtoul(end + 1, &end, 16));
+        if ( ea_hi <= ea_lo )
+          usage();
+        ea_hi--;
+      }
+      if ( *end != '\0' )
+        usage();
+      by_ea = true;
+    }
+    else if ( strcmp(arg, "-c") == 0 )
+    {
+      counts_only = true;
+    }
+    else if ( arg[0] == '-' )
+    {
+      usage();
+    }
+    else
+    {
+      files.push_back(arg);
+    }
+  }
+  if ( files.empty() )
+    usage();
+  if ( !selected )
+    memset(keep, 1, sizeof(keep));
+
+  int ret = 0;
+  for ( size_t i = 0; i < files.size(); i++ )
+    if ( !read_trace(files[i]) )
+      ret = 1;
+
+  if ( counts_only )
+  {
+    for ( int i = 0; i < FR_EV_LAST; i++ )
+      if ( counts[i] != 0 )
+        printf("%-18s %12llu\n", events[i].name, (unsigned long long)counts[i]);
+  }
+  return ret;
+}
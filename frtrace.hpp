@@ -0,0 +1,67 @@
+#ifndef __FRTRACE_HPP
+#define __FRTRACE_HPP
+
+// Binary trace of the switch and type analyses (trace.cpp).
+//
+// With FR_SWITCH_DEBUG or FR_TYPE_DEBUG the module records fixed-size
+// events into a ring instead of printing them, and appends them to a
+// trace file.  The file is a header followed by records in the byte
+// order of the machine which wrote it; frtrace.cpp prints and filters
+// them.  This header does not need the IDA SDK.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FR_TRACE_MAGIC    0x43525446    // "FTRC"
+#define FR_TRACE_VERSION  1
+
+struct fr_trace_header_t
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recsize;         // sizeof(fr_trace_rec_t)
+};
+
+struct fr_trace_rec_t
+{
+  uint32_t seq;             // 1, 2, ...: order of the events
+  uint16_t event;           // fr_trace_event_t
+  uint16_t reserved;
+  uint32_t ea;
+  uint32_t a;               // payload, see FR_TRACE_EVENTS
+  uint32_t b;
+  uint32_t c;
+};
+
+// X(id, name, a, b, c): the event and the names of its payload words
+#define FR_TRACE_EVENTS(X)                                                        \
+  X(FR_EV_DROPPED,        "dropped",           "count",  NULL,      NULL)         \
+  X(FR_EV_SW_CHECK,       "sw.check",          NULL,     NULL,      NULL)         \
+  X(FR_EV_SW_CACHED,      "sw.cached",         NULL,     NULL,      NULL)         \
+  X(FR_EV_SW_PATTERN,     "sw.pattern",        NULL,     NULL,      NULL)         \
+  X(FR_EV_SW_NO_TABLE,    "sw.no_table",       "def",    "itype",   NULL)         \
+  X(FR_EV_SW_NO_MATCH,    "sw.no_match",       "score",  "default", NULL)         \
+  X(FR_EV_SW_FOUND,       "sw.found",          "table",  "ncases",  "default")    \
+  X(FR_EV_SW_DEAD,        "sw.dead",           "start",  "end",     NULL)         \
+  X(FR_EV_TY_ARGLOCS,     "type.arglocs",      "n",      NULL,      NULL)         \
+  X(FR_EV_TY_ARGLOC,      "type.argloc",       "i",      "size",    NULL)         \
+  X(FR_EV_TY_SET_OP,      "type.set_op",       "optype", "n",       NULL)         \
+  X(FR_EV_TY_STKARG,      "type.stkarg",       "value",  "addr",    NULL)         \
+  X(FR_EV_TY_REGARG,      "type.regarg",       "reg",    NULL,      NULL)         \
+  X(FR_EV_TY_REGARG_USE,  "type.regarg_use",   "n",      "idx",     "itype")      \
+  X(FR_EV_TY_STKOFF,      "type.stack_offset", "off",    NULL,      NULL)         \
+  X(FR_EV_TY_STKVAR_FAIL, "type.stkvar_fail",  "off",    "retry",   NULL)         \
+  X(FR_EV_TY_RETLOC,      "type.retloc",       NULL,     NULL,      NULL)         \
+  X(FR_EV_TY_BB_END,      "type.bb_end",       NULL,     NULL,      NULL)         \
+  X(FR_EV_TY_DELAY,       "type.delay_slot",   "result", NULL,      NULL)         \
+  X(FR_EV_TY_ARG_TYPES,   "type.arg_types",    "n",      "nregs",   NULL)
+
+#define FR_TRACE_ENUM(id, name, a, b, c) id,
+enum fr_trace_event_t
+{
+  FR_TRACE_EVENTS(FR_TRACE_ENUM)
+  FR_EV_LAST
+};
+#undef FR_TRACE_ENUM
+
+#endif // __FRTRACE_HPP
@@ -2,8 +2,6 @@
 #ifndef __ins_hpp
 #define __ins_hpp
 
-extern instruc_t Instructions[];
-
 enum nameNum ENUM_SIZE(uint16)
 {
     fr_null = 0,            // null instruction
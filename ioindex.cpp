@@ -0,0 +1,124 @@
+#include "fr.hpp"
+#include <algorithm>
+
+// I/O port index.
+//
+// outop() looks up every immediate it prints in the ports of the device.
+// When a device is loaded its ports are copied into a sorted array, and
+// its IO class areas ("area IO NAME start:end", from the compiled config
+// file) into a sorted array of blocks.  A bitmap with one bit per 16-byte
+// line (hashed into 64K bits) says which lines hold a port or a block;
+// most immediates miss it and are rejected without a search.
+
+#define PORT_LINE_SHIFT   4
+#define PORT_MAP_BITS     0x10000
+
+struct port_entry_t
+{
+  ea_t ea;
+  const ioport_t *port;
+};
+
+static qvector<port_entry_t> port_entries;   // sorted by address
+static qvector<fr_devblock_t> port_blocks;   // sorted by address
+static uchar port_map[PORT_MAP_BITS / 8];
+
+inline uint32 map_bit(ea_t ea)
+{
+  return uint32(ea >> PORT_LINE_SHIFT) & (PORT_MAP_BITS - 1);
+}
+
+static void mark_lines(ea_t start, ea_t end)
+{
+  ea_t first = start >> PORT_LINE_SHIFT;
+  ea_t last = (end - 1) >> PORT_LINE_SHIFT;
+  if ( last - first >= PORT_MAP_BITS )
+  {
+    memset(port_map, 0xFF, sizeof(port_map));
+    return;
+  }
+  for ( ea_t line = first; line <= last; line++ )
+  {
+    uint32 bit = uint32(line) & (PORT_MAP_BITS - 1);
+    port_map[bit >> 3] |= uchar(1 << (bit & 7));
+  }
+}
+
+static bool entry_less(const port_entry_t &a, const port_entry_t &b)
+{
+  return a.ea < b.ea;
+}
+
+// build the index of the ports and IO blocks of a device.
+void fr_index_ports(const ioport_t *ports, size_t numports, const fr_device_t *dev)
+{
+  fr_ports_flush();
+  for ( size_t i = 0; i < numports; i++ )
+  {
+    port_entry_t &e = port_entries.push_back();
+    e.ea = ports[i].address;
+    e.port = &ports[i];
+    mark_lines(e.ea, e.ea + 1);
+  }
+  // stable: the first of several ports at an address wins, as before
+  std::stable_sort(port_entries.begin(), port_entries.end(), entry_less);
+
+  if ( dev != NULL )
+    port_blocks = dev->blocks;
+  for ( size_t i = 0; i < port_blocks.size(); i++ )
+    mark_lines(port_blocks[i].start, port_blocks[i].end);
+}
+
+// the port at ea or NULL.
+const ioport_t *fr_find_port(ea_t ea)
+{
+  uint32 bit = map_bit(ea);
+  if ( (port_map[bit >> 3] & (1 << (bit & 7))) == 0 )
+    return NULL;
+
+  size_t lo = 0;
+  size_t hi = port_entries.size();
+  while ( lo < hi )
+  {
+    size_t mid = (lo + hi) / 2;
+    if ( port_entries[mid].ea < ea )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if ( lo < port_entries.size() && port_entries[lo].ea == ea )
+    return port_entries[lo].port;
+  return NULL;
+}
+
+// the name of the IO block containing ea and the offset of ea in it, or NULL.
+const char *fr_find_port_block(ea_t ea, uval_t *off)
+{
+  uint32 bit = map_bit(ea);
+  if ( (port_map[bit >> 3] & (1 << (bit & 7))) == 0 )
+    return NULL;
+
+  // the last block starting at or before ea
+  size_t lo = 0;
+  size_t hi = port_blocks.size();
+  while ( lo < hi )
+  {
+    size_t mid = (lo + hi) / 2;
+    if ( port_blocks[mid].start <= ea )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if ( lo == 0 || ea >= port_blocks[lo - 1].end )
+    return NULL;
+  const fr_devblock_t &b = port_blocks[lo - 1];
+  *off = ea - b.start;
+  return b.name;
+}
+
+void fr_ports_flush(void)
+{
+  port_entries.clear();
+  port_blocks.clear();
+  memset(port_map, 0, sizeof(port_map));
+}
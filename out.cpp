@@ -49,10 +49,13 @@ static void out_reglist(const op_t &op)
   static const uint16 regs_stm0[] = { rR0,  rR1,  rR2,  rR3,  rR4,  rR5,  rR6,  rR7  };
   static const uint16 regs_ldm1[] = { rR15, rR14, rR13, rR12, rR11, rR10, rR9,  rR8  };
   static const uint16 regs_stm1[] = { rR8,  rR9,  rR10, rR11, rR12, rR13, rR14, rR15 };
-  static const uint16 regs_fpu[] = { rFR0, rFR1, rFR2, rFR3, rFR4, rFR5, rFR6, rFR7,
-                                     rFR8, rFR9, rFR10, rFR11, rFR12, rFR13, rFR14, rFR15 };
+  static const uint16 regs_fldm[] = { rFR15, rFR14, rFR13, rFR12, rFR11, rFR10, rFR9, rFR8,
+                                      rFR7,  rFR6,  rFR5,  rFR4,  rFR3,  rFR2,  rFR1, rFR0 };
+  static const uint16 regs_fstm[] = { rFR0,  rFR1,  rFR2,  rFR3,  rFR4,  rFR5,  rFR6, rFR7,
+                                      rFR8,  rFR9,  rFR10, rFR11, rFR12, rFR13, rFR14, rFR15 };
   const uint16 *regs;
   bool left;
+  int nregs = 8;
 
   switch ( cmd.itype )
   {
@@ -60,10 +63,8 @@ static void out_reglist(const op_t &op)
     case fr_stm0:   regs = regs_stm0; left = true;  break;
     case fr_ldm1:   regs = regs_ldm1; left = false; break;
     case fr_stm1:   regs = regs_stm1; left = true;  break;
-    case fr_fldm:   
-      regs = regs_fpu;
-      left = false;
-      break;
+    case fr_fldm:   regs = regs_fldm; left = false; nregs = 16; break;
+    case fr_fstm:   regs = regs_fstm; left = true;  nregs = 16; break;
 
     default:
       INTERR(10018);
@@ -74,12 +75,12 @@ static void out_reglist(const op_t &op)
   out_symbol('(');
   if ( left )
   {
-    for (int i = 0, bit = 128; bit != 0; bit >>= 1, i++)
+    for (int i = 0, bit = 1 << (nregs - 1); bit != 0; bit >>= 1, i++)
       out_reg_if_bit(regs[i], op.value, bit);
   }
   else
   {
-    for (int i = 7, bit = 1; bit <= 128; bit <<= 1, i--)
+    for (int i = nregs - 1, bit = 1; bit < (1 << nregs); bit <<= 1, i--)
       out_reg_if_bit(regs[i], op.value, bit);
   }
   out_symbol(')');
@@ -141,6 +142,7 @@ void idaapi gen_segm_header(ea_t ea)
 // Output an operand.
 bool idaapi outop(op_t &op)
 {
+  FR_STAT_SCOPE(FR_ST_OUTOP);
   switch ( op.type )
   {
     case o_near:
@@ -153,10 +155,22 @@ bool idaapi outop(op_t &op)
       {
         const ioport_t *port = find_sym(op.value);
 
+        // the address loaded by ldi:20/32 may be inside an IO block
+        const char *block = NULL;
+        uval_t off = 0;
+        if ( port == NULL && (cmd.itype == fr_ldi_20 || cmd.itype == fr_ldi_32) )
+          block = fr_find_port_block(op.value, &off);
+
         // this immediate is represented in the .cfg file
         // output the port name instead of the numeric value
         if ( port != NULL )
           out_line(port->name, COLOR_IMPNAME);
+        else if ( block != NULL )
+        {
+          out_line(block, COLOR_IMPNAME);
+          out_symbol('+');
+          OutLong(off, 16);
+        }
         else // otherwise, simply print the value
         {
           out_symbol('#');
@@ -234,6 +248,14 @@ bool idaapi outop(op_t &op)
         OutChar(' ');
         OutValue(op, OOFW_IMM );
       }
+      // @(BP, #u)
+      else if ( op_displ_imm_bp(op) )
+      {
+        out_reg(rBP);
+        out_symbol(',');
+        OutChar(' ');
+        OutValue(op, OOFW_IMM );
+      }
       else
         INTERR(10020);
 
@@ -258,6 +280,7 @@ bool idaapi outop(op_t &op)
 // Output an instruction
 void idaapi out(void)
 {
+  FR_STAT_SCOPE(FR_ST_OUT);
 
   //
   // print insn mnemonic
@@ -8,6 +8,9 @@
 // IDA database.
 static netnode helper;
 
+// scan for function prologues when a new file is loaded
+static bool scan_prologues;
+
 // FR registers names
 static const char *const RegNames[] =
 {
@@ -72,6 +75,7 @@ static const char *const RegNames[] =
   "reserved12",
   "reserved13",
   "reserved14",
+  "reserved15",
   "dbr",
 
 
@@ -96,8 +100,12 @@ static const char *const RegNames[] =
   // these 2 registers are required by the IDA kernel :
 
   "cs",
-  "ds"
+  "ds",
+
+  // TBR value, tracked like a segment register
+  "vtbr"
 };
+CASSERT(qnumber(RegNames) == rVtbr + 1);
 
 const char *const savedRegNames[] =
 {
@@ -156,12 +164,13 @@ const char *const savedRegNames[] =
   "sESR",       // Exception status
 
   // system use dedicated registers
-  "reserved9"
+  "reserved9",
   "reserved10",
   "reserved11",
   "reserved12",
   "reserved13",
   "reserved14",
+  "reserved15",
   "sDBR",       // Debug register
 
   // FR81 (80?) and up floating point registers
@@ -185,8 +194,11 @@ const char *const savedRegNames[] =
   // these 2 registers are required by the IDA kernel :
 
   "cs",
-  "ds"
+  "ds",
+
+  "sVtbr"
 };
+CASSERT(qnumber(savedRegNames) == rVtbr + 1);
 
 static size_t numports = 0;
 static ioport_t *ports = NULL;
@@ -195,19 +207,102 @@ char device[MAXSTR] = "";
 // include IO common routines (such as set_device_name, apply_config_file, etc..)
 #include "iocommon.cpp" // "../iocommon.cpp"
 
+// load the ports of a device and index them for find_sym().
+// only applying the config file needs the text parser of set_device_name(),
+// the ports are taken from the compiled config file if there is one.
+static void load_device(const char *dev, int respect_info)
+{
+  char cfgfile[QMAXFILE];
+  get_cfg_filename(cfgfile, sizeof(cfgfile));
+  const fr_device_t *d = fr_find_device(cfgfile, dev);
+  if ( d != NULL && respect_info == IORESP_NONE )
+  {
+    free_ioports(ports, numports);
+    ports = NULL;
+    numports = 0;
+    if ( dev != device )
+      qstrncpy(device, dev, sizeof(device));
+    fr_index_ports(d->ports.begin(), d->ports.size(), d);
+  }
+  else
+  {
+    set_device_name(dev, respect_info);
+    fr_index_ports(ports, numports, d);
+  }
+}
+
 inline static void idaapi choose_device(TView *[] = NULL, int = 0)
 {
   char cfgfile[QMAXFILE];
   get_cfg_filename(cfgfile, sizeof(cfgfile));
   if ( choose_ioport_device(cfgfile, device, sizeof(device), NULL) )
-    set_device_name(device, IORESP_NONE);
+    load_device(device, IORESP_NONE);
 }
 
 // returns a pointer to a ioport_t object if address was found in the config file.
 // otherwise, returns NULL.
 const ioport_t *find_sym(ea_t address)
 {
-  return find_ioport(ports, numports, address);
+  return fr_find_port(address);
+}
+
+// drop everything the module caches about the database contents.
+// the stored state (emu_store) is saved and loaded with the database.
+static void fr_flush_caches(void)
+{
+  fr_predecode_flush();
+  fr_insn_cache_flush();
+  fr_cfg_flush();
+  fr_const_flush();
+  fr_defs_flush();
+  fr_switch_flush();
+  fr_tbr_flush();
+}
+
+// Edit/Other menu item: scan an existing database for function prologues
+#define SCAN_MENU_PATH  "Edit/Other/"
+#define SCAN_MENU_NAME  "Scan for FR function prologues"
+
+static bool idaapi scan_prologues_menu(void *)
+{
+  fr_scan_prologues();
+  return true;
+}
+
+// Database event notifications
+static int idaapi idb_callback(void *, int code, va_list va)
+{
+	switch ( code )
+	{
+	case idb_event::byte_patched:
+		{
+			ea_t ea = va_arg(va, ea_t);
+			fr_predecode_invalidate(ea, ea + 1);
+			fr_insn_cache_invalidate(ea, ea + 1);
+			fr_cfg_invalidate(ea, ea + 1);
+			fr_const_invalidate(ea, ea + 1);
+			fr_defs_invalidate(ea, ea + 1);
+			fr_switch_invalidate(ea, ea + 1);
+		}
+		break;
+
+	case idb_event::func_updated:
+	case idb_event::set_func_start:
+	case idb_event::set_func_end:
+	case idb_event::deleting_func:
+	case idb_event::func_tail_appended:
+	case idb_event::func_tail_removed:
+		{
+			func_t *pfn = va_arg(va, func_t *);
+			if ( code == idb_event::deleting_func )
+				fr_store_forget(pfn->startEA);
+			fr_cfg_invalidate(pfn->startEA, pfn->startEA + 1);
+			fr_const_invalidate(pfn->startEA, pfn->startEA + 1);
+			fr_defs_invalidate(pfn->startEA, pfn->startEA + 1);
+		}
+		break;
+	}
+	return 0;
 }
 
 // The kernel event notifications
@@ -230,29 +325,100 @@ static int idaapi notify(processor_t::idp_notify msgid, ...)
 	case processor_t::init:
 		inf.mf = 1;
 		helper.create("$ fr");
+		fr_regs_init();
+		hook_to_notification_point(HT_IDB, idb_callback, NULL);
+		add_menu_item(SCAN_MENU_PATH, SCAN_MENU_NAME, NULL, SETMENU_APP, scan_prologues_menu, NULL);
 	default:
 		break;
 
 	case processor_t::term:
+		unhook_from_notification_point(HT_IDB, idb_callback, NULL);
+		del_menu_item(SCAN_MENU_PATH SCAN_MENU_NAME);
+		fr_stats_report();
+		fr_trace_close();
+		fr_timeline_close();
+		fr_flush_caches();
+		fr_store_flush();
+		fr_ports_flush();
+		fr_devdb_flush();
 		free_ioports(ports, numports);
 		break;
 
+	case processor_t::undefine:
+		{
+			ea_t ea = va_arg(va, ea_t);
+			fr_insn_cache_invalidate(ea, ea + 1);
+			fr_cfg_invalidate(ea, ea + 1);
+			fr_const_invalidate(ea, ea + 1);
+			fr_defs_invalidate(ea, ea + 1);
+			fr_switch_invalidate(ea, ea + 1);
+		}
+		break;
+
+	case processor_t::add_cref:
+	case processor_t::del_cref:
+		{
+			// the switch window stops at instructions with several
+			// predecessors
+			va_arg(va, ea_t);
+			ea_t to = va_arg(va, ea_t);
+			fr_switch_invalidate(to, to + 1);
+		}
+		break;
+
+	case processor_t::func_bounds:
+		{
+			int *possible_return_code = va_arg(va, int *);
+			func_t *pfn = va_arg(va, func_t *);
+			if ( *possible_return_code == FIND_FUNC_OK )
+				fr_add_indirect_xrefs(pfn);
+		}
+		break;
+
+	case processor_t::auto_empty_finally:
+		fr_trace_flush();
+		fr_timeline_flush();
+		break;
+
+	case processor_t::move_segm:
+	case processor_t::endbinary:
+		fr_flush_caches();
+		break;
+
 	case processor_t::newfile:
+		fr_flush_caches();
+		fr_store_flush();
 		choose_device();
-		set_device_name(device, IORESP_ALL);
+		load_device(device, IORESP_ALL);
+		fr_import_vectors(FR_TBR_RESET);
+		if ( scan_prologues )
+			fr_scan_prologues();
+		break;
+
+	case processor_t::newseg:
+		{
+			segment_t *s = va_arg(va, segment_t *);
+			fr_tbr_newseg(s);
+		}
 		break;
 
 	case processor_t::oldfile:
+		fr_flush_caches();
+		fr_tbr_oldfile();
+		fr_store_load(helper);
 		{
 			char buf[MAXSTR];
 			if ( helper.supval(-1, buf, sizeof(buf)) > 0 )
-				set_device_name(buf, IORESP_NONE);
+				load_device(buf, IORESP_NONE);
 		}
 		break;
 
 	case processor_t::closebase:
+		fr_flush_caches();
+		// fallthrough
 	case processor_t::savebase:
 		helper.supset(-1, device);
+		fr_store_save(helper);
 		break;
 
 	case processor_t::is_basic_block_end:
@@ -395,11 +561,55 @@ static int idaapi notify(processor_t::idp_notify msgid, ...)
 
 const char *idaapi set_idp_options(
     const char *keyword,
-    int /*value_type*/,
-    const void * /*value*/ )
+    int value_type,
+    const void *value )
 {
     if ( keyword != NULL )
-        return IDPOPT_BADKEY;
+    {
+        // FR_STATS_FILE = "path": append the callback statistics to a file
+        // instead of the output window (only with FR_STATS)
+        if ( strcmp(keyword, "FR_STATS_FILE") == 0 )
+        {
+            if ( value_type != IDPOPT_STR )
+                return IDPOPT_BADTYPE;
+            fr_stats_set_file((const char *)value);
+            return IDPOPT_OK;
+        }
+        // FR_TRACE_FILE = "path": the trace file (only with FR_SWITCH_DEBUG
+        // or FR_TYPE_DEBUG)
+        if ( strcmp(keyword, "FR_TRACE_FILE") == 0 )
+        {
+            if ( value_type != IDPOPT_STR )
+                return IDPOPT_BADTYPE;
+            fr_trace_set_file((const char *)value);
+            return IDPOPT_OK;
+        }
+        // FR_TIMELINE_FILE = "path": the analysis timeline (only with
+        // FR_TIMELINE)
+        if ( strcmp(keyword, "FR_TIMELINE_FILE") == 0 )
+        {
+            if ( value_type != IDPOPT_STR )
+                return IDPOPT_BADTYPE;
+            fr_timeline_set_file((const char *)value);
+            return IDPOPT_OK;
+        }
+        // FR_TIMELINE_MIN_US = n: shorter spans are not written
+        if ( strcmp(keyword, "FR_TIMELINE_MIN_US") == 0 )
+        {
+            if ( value_type != IDPOPT_NUM )
+                return IDPOPT_BADTYPE;
+            fr_timeline_set_min_us(*(const uval_t *)value);
+            return IDPOPT_OK;
+        }
+        // FR_SCAN_PROLOGUES = YES: scan for function prologues when a new
+        // file is loaded
+        if ( strcmp(keyword, "FR_SCAN_PROLOGUES") != 0 )
+            return IDPOPT_BADKEY;
+        if ( value_type != IDPOPT_BIT )
+            return IDPOPT_BADTYPE;
+        scan_prologues = *(const int *)value != 0;
+        return IDPOPT_OK;
+    }
 
     char cfgfile[QMAXFILE];
     get_cfg_filename(cfgfile, sizeof(cfgfile));
@@ -410,7 +620,7 @@ const char *idaapi set_idp_options(
     }
     else
     {
-      set_device_name(device, IORESP_NONE);
+      load_device(device, IORESP_NONE);
     }
     return IDPOPT_OK;
 }
@@ -619,7 +829,7 @@ processor_t LPH =
       NULL,                 // Register descriptions
       NULL,                 // Pointer to CPU registers
 
-      rVcs, rVds,
+      rVcs, rVtbr,
       0,                    // size of a segment register
       rVcs, rVds,
 
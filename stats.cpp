@@ -0,0 +1,134 @@
+#include "fr.hpp"
+
+// Callback counters.
+//
+// With FR_STATS defined, the processor callbacks and the helpers they
+// spend most of their time in open a scope (FR_STAT_SCOPE) which counts
+// the call and its time, and every neighbour decoded through
+// fr_decode_insn() is charged to the innermost open scope.  A callback
+// which calls itself through the kernel is only timed once.  The table,
+// followed by the hit rate of the decode cache, is printed at term, to the
+// output window or to the FR_STATS_FILE option.
+// Without FR_STATS the scopes compile to nothing and this file is empty.
+
+#ifdef FR_STATS
+#include <chrono>
+
+struct fr_stat_t
+{
+  uint64 calls;
+  uint64 total_ns;
+  uint64 max_ns;
+  uint64 decodes;     // fr_decode_insn() calls
+  uint64 misses;      // ... which were not cached
+};
+
+static const char *const stat_names[FR_ST_LAST] =
+{
+  "ana",
+  "emu",
+  "out",
+  "outop",
+  "is_switch",
+  "func_frame",
+  "regarg_type",
+  "search_back",
+};
+
+static fr_stat_t stats[FR_ST_LAST];
+static uint64 decodes;                    // all fr_decode_insn() calls
+static uint64 decode_misses;
+static int stat_depth[FR_ST_LAST];        // open scopes per id
+static fr_stat_scope_t *stat_inner;       // innermost open scope
+static char stats_file[QMAXPATH];
+
+inline uint64 now_ns(void)
+{
+  return uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+fr_stat_scope_t::fr_stat_scope_t(fr_stat_id_t _id) : id(_id), outer(stat_inner)
+{
+  stat_inner = this;
+  stats[id].calls++;
+  start = stat_depth[id]++ == 0 ? now_ns() : 0;
+}
+
+fr_stat_scope_t::~fr_stat_scope_t(void)
+{
+  stat_inner = outer;
+  if ( --stat_depth[id] != 0 )
+    return;
+  fr_stat_t &s = stats[id];
+  uint64 ns = now_ns() - start;
+  s.total_ns += ns;
+  s.max_ns = qmax(s.max_ns, ns);
+}
+
+void fr_stat_decode(bool miss)
+{
+  decodes++;
+  if ( miss )
+    decode_misses++;
+  if ( stat_inner == NULL )
+    return;
+  fr_stat_t &s = stats[stat_inner->id];
+  s.decodes++;
+  if ( miss )
+    s.misses++;
+}
+
+static AS_PRINTF(2, 3) void report_line(FILE *fp, const char *format, ...)
+{
+  va_list va;
+  va_start(va, format);
+  if ( fp != NULL )
+    qvfprintf(fp, format, va);
+  else
+    vmsg(format, va);
+  va_end(va);
+}
+
+// print and reset the counters.
+void fr_stats_report(void)
+{
+  FILE *fp = NULL;
+  if ( stats_file[0] != '\0' )
+  {
+    fp = qfopen(stats_file, "a");
+    if ( fp == NULL )
+      msg("FR: can not open %s, printing the statistics here\n", stats_file);
+  }
+
+  report_line(fp, "FR: %-12s %12s %12s %10s %10s %12s %12s\n",
+              "callback", "calls", "total ms", "avg ns", "max ns", "decodes", "misses");
+  for ( int i = 0; i < FR_ST_LAST; i++ )
+  {
+    const fr_stat_t &s = stats[i];
+    if ( s.calls == 0 )
+      continue;
+    report_line(fp, "FR: %-12s %12" FMT_64 "u %12" FMT_64 "u %10" FMT_64 "u %10" FMT_64 "u %12" FMT_64 "u %12" FMT_64 "u\n",
+                stat_names[i], s.calls, s.total_ns / 1000000, s.total_ns / s.calls,
+                s.max_ns, s.decodes, s.misses);
+  }
+  if ( decodes != 0 )
+  {
+    uint64 hits = decodes - decode_misses;
+    report_line(fp, "FR: decode cache: %" FMT_64 "u hits, %" FMT_64 "u misses (%u%% of decodes avoided)\n",
+                hits, decode_misses, uint32(hits * 100 / decodes));
+  }
+  if ( fp != NULL )
+    qfclose(fp);
+  memset(stats, 0, sizeof(stats));
+  decodes = 0;
+  decode_misses = 0;
+}
+
+// the file the statistics are appended to; the output window if empty.
+void fr_stats_set_file(const char *file)
+{
+  qstrncpy(stats_file, file, sizeof(stats_file));
+}
+
+#endif // FR_STATS
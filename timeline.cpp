@@ -0,0 +1,117 @@
+#include "fr.hpp"
+
+// Analysis timeline.
+//
+// With FR_TIMELINE defined, the analysis entry points open a span
+// (FR_SPAN) and every span which lasts at least FR_TIMELINE_MIN_US
+// microseconds is written, when it ends, as a complete ("X") event of the
+// Chrome trace format, tagged with its ea and the start of the function
+// which contains it.  The file can be opened in chrome://tracing or
+// Perfetto.  It is the FR_TIMELINE_FILE option, or the database name with
+// .trace.json appended.  It uses the array form of the format, whose
+// closing bracket is optional, so the file written so far can be opened
+// even if IDA is killed during a stall; it is flushed once a second.
+// Without FR_TIMELINE the spans compile to nothing and this file is empty.
+
+#ifdef FR_TIMELINE
+#include <chrono>
+
+#define TIMELINE_MIN_US   10        // default FR_TIMELINE_MIN_US
+#define TIMELINE_FLUSH_NS 1000000000
+
+static FILE *timeline_fp;
+static char timeline_file[QMAXPATH];
+static uint64 timeline_min_ns = TIMELINE_MIN_US * 1000;
+static uint64 timeline_base;      // start of the first span of the file
+static uint64 timeline_flushed;   // time of the last flush
+
+inline uint64 now_ns(void)
+{
+  return uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static bool open_timeline(void)
+{
+  if ( timeline_fp != NULL )
+    return true;
+  char path[QMAXPATH];
+  if ( timeline_file[0] != '\0' )
+    qstrncpy(path, timeline_file, sizeof(path));
+  else
+    qsnprintf(path, sizeof(path), "%s.trace.json", database_idb);
+  timeline_fp = qfopen(path, "w");
+  if ( timeline_fp == NULL )
+  {
+    msg("FR: can not create the timeline file %s\n", path);
+    return false;
+  }
+  timeline_flushed = now_ns();
+  qfprintf(timeline_fp,
+           "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"fr\"}}");
+  return true;
+}
+
+// print ns as microseconds with 3 decimals
+static void print_us(const char *key, uint64 ns)
+{
+  qfprintf(timeline_fp, ",\"%s\":%" FMT_64 "u.%03u", key, ns / 1000, uint32(ns % 1000));
+}
+
+fr_span_t::fr_span_t(const char *_name, ea_t _ea) : name(_name), ea(_ea)
+{
+  start = now_ns();
+  if ( timeline_base == 0 )
+    timeline_base = start;
+}
+
+fr_span_t::~fr_span_t(void)
+{
+  uint64 end = now_ns();
+  if ( end - start < timeline_min_ns || !open_timeline() )
+    return;
+  func_t *pfn = get_func(ea);
+  qfprintf(timeline_fp, ",\n{\"name\":\"%s\",\"cat\":\"fr\",\"ph\":\"X\"", name);
+  print_us("ts", start - timeline_base);
+  print_us("dur", end - start);
+  qfprintf(timeline_fp, ",\"pid\":1,\"tid\":1,\"args\":{\"ea\":\"0x%a\"", ea);
+  if ( pfn != NULL )
+    qfprintf(timeline_fp, ",\"func\":\"0x%a\"", pfn->startEA);
+  qfprintf(timeline_fp, "}}");
+  if ( end - timeline_flushed >= TIMELINE_FLUSH_NS )
+  {
+    qflush(timeline_fp);
+    timeline_flushed = end;
+  }
+}
+
+void fr_timeline_flush(void)
+{
+  if ( timeline_fp != NULL )
+    qflush(timeline_fp);
+}
+
+// close the timeline file. the next span starts a new one.
+void fr_timeline_close(void)
+{
+  if ( timeline_fp != NULL )
+  {
+    qfprintf(timeline_fp, "\n]\n");
+    qfclose(timeline_fp);
+    timeline_fp = NULL;
+  }
+  timeline_base = 0;
+}
+
+void fr_timeline_set_file(const char *file)
+{
+  qstrncpy(timeline_file, file, sizeof(timeline_file));
+}
+
+// spans shorter than this many microseconds are not written.
+void fr_timeline_set_min_us(uval_t us)
+{
+  timeline_min_ns = uint64(us) * 1000;
+}
+
+#endif // FR_TIMELINE
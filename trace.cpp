@@ -0,0 +1,147 @@
+#include "fr.hpp"
+
+// Trace ring.
+//
+// With FR_SWITCH_DEBUG or FR_TYPE_DEBUG the switch and type analyses
+// record their steps with fr_trace() instead of printing them.  A record
+// is a few words (see frtrace.hpp) written into a fixed ring: a writer
+// claims a slot with one atomic increment and publishes it by storing its
+// sequence number last, so writers never wait for each other or for the
+// flush.  The flush runs on the main thread when emu() finds the ring half
+// full, when auto-analysis ends and at term.  It appends the published
+// records to the trace file: the FR_TRACE_FILE option, or the database
+// name with .frtrace appended.  Records overwritten before they could be
+// flushed are replaced by one FR_EV_DROPPED record.
+
+#ifdef FR_TRACE
+#include <atomic>
+
+#define TRACE_RING_BITS   16
+#define TRACE_RING_SIZE   (1 << TRACE_RING_BITS)
+
+struct trace_slot_t
+{
+  std::atomic<uint32> seq;      // seq of rec, 0 while it is written
+  fr_trace_rec_t rec;
+};
+
+static trace_slot_t ring[TRACE_RING_SIZE];
+static std::atomic<uint32> ring_head;     // records claimed
+static uint32 ring_tail;                  // records flushed
+static FILE *trace_fp;
+static char trace_file[QMAXPATH];
+
+void fr_trace(fr_trace_event_t event, ea_t ea, uint32 a, uint32 b, uint32 c)
+{
+  uint32 seq = ring_head.fetch_add(1, std::memory_order_relaxed) + 1;
+  trace_slot_t &s = ring[seq & (TRACE_RING_SIZE - 1)];
+  s.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.rec.seq = seq;
+  s.rec.event = uint16(event);
+  s.rec.reserved = 0;
+  s.rec.ea = uint32(ea);
+  s.rec.a = a;
+  s.rec.b = b;
+  s.rec.c = c;
+  s.seq.store(seq, std::memory_order_release);
+}
+
+static bool open_trace(void)
+{
+  if ( trace_fp != NULL )
+    return true;
+  char path[QMAXPATH];
+  if ( trace_file[0] != '\0' )
+    qstrncpy(path, trace_file, sizeof(path));
+  else
+    qsnprintf(path, sizeof(path), "%s.frtrace", database_idb);
+  trace_fp = qfopen(path, "wb");
+  if ( trace_fp == NULL )
+  {
+    msg("FR: can not create the trace file %s\n", path);
+    return false;
+  }
+  fr_trace_header_t h;
+  h.magic = FR_TRACE_MAGIC;
+  h.version = FR_TRACE_VERSION;
+  h.recsize = sizeof(fr_trace_rec_t);
+  qfwrite(trace_fp, &h, sizeof(h));
+  return true;
+}
+
+// seq is the last record which was lost.
+static void write_dropped(uint32 seq, uint32 count)
+{
+  fr_trace_rec_t r;
+  memset(&r, 0, sizeof(r));
+  r.seq = seq;
+  r.event = FR_EV_DROPPED;
+  r.a = count;
+  qfwrite(trace_fp, &r, sizeof(r));
+}
+
+// append the records published since the last flush to the trace file.
+void fr_trace_flush(void)
+{
+  uint32 head = ring_head.load(std::memory_order_acquire);
+  if ( head == ring_tail || !open_trace() )
+    return;
+
+  uint32 dropped = 0;
+  if ( head - ring_tail > TRACE_RING_SIZE )
+  {
+    dropped = head - ring_tail - TRACE_RING_SIZE;
+    ring_tail = head - TRACE_RING_SIZE;
+  }
+  uint32 seq;
+  for ( seq = ring_tail + 1; seq - 1 != head; seq++ )
+  {
+    const trace_slot_t &s = ring[seq & (TRACE_RING_SIZE - 1)];
+    fr_trace_rec_t r;
+    uint32 before = s.seq.load(std::memory_order_acquire);
+    r = s.rec;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if ( before != seq || s.seq.load(std::memory_order_relaxed) != seq )
+    {
+      // still being written, or already overwritten
+      dropped++;
+      continue;
+    }
+    if ( dropped != 0 )
+    {
+      write_dropped(seq - 1, dropped);
+      dropped = 0;
+    }
+    qfwrite(trace_fp, &r, sizeof(r));
+  }
+  if ( dropped != 0 )
+    write_dropped(seq - 1, dropped);
+  ring_tail = head;
+  qflush(trace_fp);
+}
+
+// flush if the ring is half full.
+void fr_trace_poll(void)
+{
+  if ( ring_head.load(std::memory_order_relaxed) - ring_tail >= TRACE_RING_SIZE / 2 )
+    fr_trace_flush();
+}
+
+// flush and close the trace file. the next flush starts a new one.
+void fr_trace_close(void)
+{
+  fr_trace_flush();
+  if ( trace_fp != NULL )
+  {
+    qfclose(trace_fp);
+    trace_fp = NULL;
+  }
+}
+
+void fr_trace_set_file(const char *file)
+{
+  qstrncpy(trace_file, file, sizeof(trace_file));
+}
+
+#endif // FR_TRACE